@@ -1,6 +1,37 @@
 ﻿#include <type_traits> // Для std::convertible_to, std::same_as, std::has_virtual_destructor
 #include <string>      // Для std::string
 #include <iostream>    // Для вывода
+#include <concepts>    // Для std::equality_comparable
+#include <vector>
+#include <memory>      // Для std::allocator, std::destroy_at
+#include <cstdint>
+#include <cstring>     // Для std::memcpy
+#include <bit>         // Для std::countr_zero
+#include <utility>
+#include <chrono>      // Для бенчмарков (--bench)
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include <span>        // Для FormatBuffer
+#include <string_view>
+#include <charconv>    // Для std::to_chars
+#include <cstdio>      // Для FormatLogger
+#include <atomic>
+#include <new>         // Для счетчика выделений памяти в бенчмарках
+#include <cstdlib>
+#include <stdexcept>   // Для std::invalid_argument
+#include <cmath>       // Для оценки качества хеша
+#include <limits>
+#include <array>       // Для PerfectHashMap
+#include <mutex>       // Для ConcurrentHashSet
+#include <shared_mutex>
+#include <thread>
+#include <unordered_set>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONCEPT_HASH_MAP_SSE2 1
+#include <emmintrin.h> // SSE2: сравнение 16 байт управления одной инструкцией
+#endif
 
 // --- Концепт ComplexConcept<T> ---
 template <typename T>
@@ -57,14 +88,872 @@ struct AllGoodButVirtualDestructor : public HasVirtualDestructor {
 };
 
 
+// --- Форматирование без выделений памяти ---
+// toString() из ComplexConcept возвращает std::string и на длинных строках выделяет
+// память на каждый вызов. Тип может вместо этого дописывать себя в буфер вызывающего:
+// void appendTo(FormatBuffer&) const. Форматирование (appendFormatted, FormatLogger)
+// предпочитает appendTo и только без него вызывает toString().
+
+// Буфер поверх памяти вызывающего (массив на стеке, кусок буфера лога).
+// Не поместившееся отбрасывается, truncated() это показывает.
+class FormatBuffer {
+public:
+    explicit FormatBuffer(std::span<char> storage) : memory(storage) {}
+
+    void append(std::string_view text) {
+        size_t fits = std::min(text.size(), memory.size() - used);
+        std::memcpy(memory.data() + used, text.data(), fits);
+        used += fits;
+        overflow |= fits < text.size();
+    }
+    void append(char c) { append(std::string_view(&c, 1)); }
+    void append(long value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        append(std::string_view(digits, result.ptr - digits));
+    }
+
+    std::string_view view() const { return std::string_view(memory.data(), used); }
+    size_t size() const { return used; }
+    bool truncated() const { return overflow; }
+    void clear() {
+        used = 0;
+        overflow = false;
+    }
+
+private:
+    std::span<char> memory;
+    size_t used = 0;
+    bool overflow = false;
+};
+
+template <typename T>
+concept AppendFormattable = requires(const T & t, FormatBuffer & out) {
+    t.appendTo(out);
+};
+
+// Текстовое представление value в out: appendTo без выделений, иначе toString()
+template <typename T>
+    requires AppendFormattable<T> || ComplexConcept<T>
+void appendFormatted(FormatBuffer& out, const T& value) {
+    if constexpr (AppendFormattable<T>) {
+        value.appendTo(out);
+    }
+    else {
+        out.append(value.toString()); // Запасной путь: временная строка на каждый вызов
+    }
+}
+
+// Лог по строке на объект в std::FILE*. Строки форматируются сразу в общий буфер
+// и уходят в файл одним fwrite, когда он заполняется, - на запись ни выделений,
+// ни системных вызовов. Строка длиннее всего буфера обрезается.
+class FormatLogger {
+public:
+    explicit FormatLogger(std::FILE* output, size_t bufferSize = 64 * 1024)
+        : sink(output), storage(std::max<size_t>(bufferSize, 2)) {
+    }
+    FormatLogger(const FormatLogger&) = delete;
+    FormatLogger& operator=(const FormatLogger&) = delete;
+    ~FormatLogger() { flush(); }
+
+    template <typename T>
+    void log(const T& value) {
+        if (!tryAppendLine(value) && used > 0) {
+            flush();
+            tryAppendLine(value);
+        }
+    }
+
+    void flush() {
+        if (used > 0) std::fwrite(storage.data(), 1, used, sink);
+        used = 0;
+    }
+
+    size_t records() const { return record_count; }
+
+private:
+    std::FILE* sink;
+    std::vector<char> storage;
+    size_t used = 0;
+    size_t record_count = 0;
+
+    // Форматирует строку в свободный хвост буфера; при нехватке места (а буфер
+    // не пуст) откатывает ее и возвращает false
+    template <typename T>
+    bool tryAppendLine(const T& value) {
+        if (storage.size() - used < 2) return false; // Нет места даже под символ и перевод строки
+        FormatBuffer line(std::span<char>(storage.data() + used, storage.size() - used - 1));
+        appendFormatted(line, value);
+        if (line.truncated() && used > 0) return false;
+        storage[used + line.size()] = '\n'; // Место под перевод строки зарезервировано
+        used += line.size() + 1;
+        ++record_count;
+        return true;
+    }
+};
+
+
+// --- ConceptHashMap<K, V> ---
+// Хеш-таблица с открытой адресацией в стиле SwissTable для ключей ComplexConcept:
+// хеш берется прямо из K::hash(). На каждый слот - байт управления (пусто, удалено
+// или 7 младших бит хеша); байты просматриваются группами: с SSE2 - 16 байт одной
+// инструкцией, без SSE2 - 8 байт в 64-битном слове (SWAR). Ключи сравниваются только
+// в слотах, где совпали 7 бит хеша, поэтому почти любой поиск - одна группа.
+
+// Ключ таблицы: ComplexConcept, сравнение на равенство и hash() у константного объекта
+template <typename K>
+concept HashMapKey = ComplexConcept<K> && std::equality_comparable<K> && requires(const K & k) {
+    { k.hash() } -> std::convertible_to<long>;
+};
+
+namespace detail {
+    // K::hash() бывает слабым (например, просто id), поэтому перемешиваем его финализатором murmur3
+    inline uint64_t mixHash(long hash) {
+        uint64_t h = static_cast<uint64_t>(hash);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Байты управления: свободные слоты - отрицательные, занятые - 7 бит хеша (0..127)
+    constexpr int8_t kEmpty = -128;
+    constexpr int8_t kDeleted = -2;
+
+    // Совпавшие байты группы: по биту на байт (SSE2) или старший бит каждого байта (SWAR)
+    template <int Shift>
+    class BitMask {
+    public:
+        explicit BitMask(uint64_t bits) : mask(bits) {}
+        explicit operator bool() const { return mask != 0; }
+        size_t lowest() const { return static_cast<size_t>(std::countr_zero(mask)) >> Shift; }
+        void dropLowest() { mask &= mask - 1; }
+
+    private:
+        uint64_t mask;
+    };
+
+#ifdef CONCEPT_HASH_MAP_SSE2
+    struct Group {
+        static constexpr size_t kWidth = 16;
+        __m128i ctrl;
+
+        explicit Group(const int8_t* position)
+            : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(position))) {
+        }
+        BitMask<0> match(int8_t h2) const {
+            return BitMask<0>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl))));
+        }
+        BitMask<0> matchEmpty() const { return match(kEmpty); }
+        BitMask<0> matchFree() const { // Пустые и удаленные - у них установлен знаковый бит
+            return BitMask<0>(static_cast<uint32_t>(_mm_movemask_epi8(ctrl)));
+        }
+    };
+#else
+    struct Group {
+        static_assert(std::endian::native == std::endian::little, "SWAR-группа рассчитана на little-endian");
+        static constexpr size_t kWidth = 8;
+        static constexpr uint64_t kLsbs = 0x0101010101010101ULL;
+        static constexpr uint64_t kMsbs = 0x8080808080808080ULL;
+        uint64_t ctrl;
+
+        explicit Group(const int8_t* position) { std::memcpy(&ctrl, position, sizeof(ctrl)); }
+        // Возможны ложные совпадения выше настоящего - их отсеивает сравнение ключей
+        BitMask<3> match(int8_t h2) const {
+            uint64_t x = ctrl ^ (kLsbs * static_cast<uint8_t>(h2));
+            return BitMask<3>((x - kLsbs) & ~x & kMsbs);
+        }
+        BitMask<3> matchEmpty() const { return BitMask<3>(ctrl & (~ctrl << 6) & kMsbs); } // 0x80, но не 0xFE
+        BitMask<3> matchFree() const { return BitMask<3>(ctrl & kMsbs); }
+    };
+#endif
+}
+
+template <HashMapKey K, typename V>
+class ConceptHashMap {
+public:
+    ConceptHashMap() = default;
+    explicit ConceptHashMap(size_t expected) { reserve(expected); }
+    ConceptHashMap(const ConceptHashMap&) = delete;
+    ConceptHashMap& operator=(const ConceptHashMap&) = delete;
+
+    ~ConceptHashMap() {
+        destroyAll();
+        if (slots) allocator.deallocate(slots, capacity_);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return capacity_; }
+
+    V* find(const K& key) {
+        size_t index = findIndex(key, mix(key));
+        return index == npos ? nullptr : &slots[index].value;
+    }
+    const V* find(const K& key) const { return const_cast<ConceptHashMap*>(this)->find(key); }
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    // Вставка, если ключа еще нет: {значение, была ли вставка}
+    template <typename... Args>
+    std::pair<V*, bool> tryEmplace(const K& key, Args&&... args) {
+        uint64_t hash = mix(key);
+        size_t index = findIndex(key, hash);
+        if (index != npos) return { &slots[index].value, false };
+
+        if (growth_left == 0) grow();
+        index = findFree(hash);
+        if (ctrl[index] == detail::kEmpty) --growth_left; // Повторное использование удаленного слота рост не тратит
+        ::new (static_cast<void*>(&slots[index])) Slot{ key, V(std::forward<Args>(args)...) };
+        ctrl[index] = static_cast<int8_t>(hash & 0x7F);
+        ++size_;
+        return { &slots[index].value, true };
+    }
+
+    V& operator[](const K& key) { return *tryEmplace(key).first; }
+
+    bool erase(const K& key) {
+        size_t index = findIndex(key, mix(key));
+        if (index == npos) return false;
+        std::destroy_at(&slots[index]);
+        --size_;
+        // Группа с пустым слотом никогда не заполнялась целиком, значит, поиск ни одного
+        // ключа не уходил дальше нее - слот можно сделать пустым, а не удаленным
+        if (detail::Group(ctrl.data() + (index & ~(detail::Group::kWidth - 1))).matchEmpty()) {
+            ctrl[index] = detail::kEmpty;
+            ++growth_left;
+        }
+        else {
+            ctrl[index] = detail::kDeleted;
+        }
+        return true;
+    }
+
+    void reserve(size_t count) {
+        size_t needed = detail::Group::kWidth;
+        while (maxLoad(needed) < count) needed *= 2;
+        if (needed > capacity_) rehash(needed);
+    }
+
+    void clear() {
+        destroyAll();
+        std::fill(ctrl.begin(), ctrl.end(), detail::kEmpty);
+        size_ = 0;
+        growth_left = maxLoad(capacity_);
+    }
+
+    // fn(const K&, const V&) для каждой пары, в порядке слотов
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl[i] >= 0) fn(slots[i].key, slots[i].value);
+        }
+    }
+
+private:
+    struct Slot {
+        K key;
+        V value;
+    };
+    static constexpr size_t npos = SIZE_MAX;
+
+    std::vector<int8_t> ctrl;
+    Slot* slots = nullptr;
+    std::allocator<Slot> allocator;
+    size_t capacity_ = 0;     // Степень двойки, кратная ширине группы
+    size_t size_ = 0;
+    size_t growth_left = 0;   // Сколько еще пустых слотов можно занять до перестроения
+
+    static size_t maxLoad(size_t capacity) { return capacity - capacity / 8; } // Заполнение до 7/8
+
+    static uint64_t mix(const K& key) { return detail::mixHash(key.hash()); }
+
+    // Группы просматриваются с треугольным шагом: при числе групп - степени двойки обходятся все.
+    // visit(base, group, result) возвращает true, когда результат найден и просмотр закончен
+    template <typename Visit>
+    size_t probe(uint64_t hash, Visit&& visit) const {
+        size_t group_mask = capacity_ / detail::Group::kWidth - 1;
+        size_t group = (hash >> 7) & group_mask;
+        size_t result = npos;
+        for (size_t step = 1;; ++step) {
+            size_t base = group * detail::Group::kWidth;
+            if (visit(base, detail::Group(ctrl.data() + base), result)) return result;
+            group = (group + step) & group_mask;
+        }
+    }
+
+    size_t findIndex(const K& key, uint64_t hash) const {
+        if (capacity_ == 0) return npos;
+        int8_t h2 = static_cast<int8_t>(hash & 0x7F);
+        return probe(hash, [&](size_t base, const detail::Group& group, size_t& result) {
+            for (auto match = group.match(h2); match; match.dropLowest()) {
+                size_t index = base + match.lowest();
+                if (slots[index].key == key) {
+                    result = index;
+                    return true;
+                }
+            }
+            return static_cast<bool>(group.matchEmpty()); // Пустой слот - ключа в таблице нет
+        });
+    }
+
+    size_t findFree(uint64_t hash) const {
+        return probe(hash, [](size_t base, const detail::Group& group, size_t& result) {
+            auto free = group.matchFree();
+            if (free) result = base + free.lowest();
+            return static_cast<bool>(free);
+        });
+    }
+
+    void grow() {
+        if (capacity_ == 0) {
+            rehash(detail::Group::kWidth);
+        }
+        else if (size_ <= maxLoad(capacity_) / 2) {
+            rehash(capacity_); // Рост съели удаленные слоты - достаточно перестроить на месте
+        }
+        else {
+            rehash(capacity_ * 2);
+        }
+    }
+
+    // Побайтное перемещение, если для слота оно равносильно move + destroy
+    static void relocate(Slot* to, Slot* from) {
+        if constexpr (std::is_trivially_copyable_v<Slot>) {
+            std::memcpy(static_cast<void*>(to), from, sizeof(Slot));
+        }
+        else {
+            ::new (static_cast<void*>(to)) Slot{ std::move(from->key), std::move(from->value) };
+            std::destroy_at(from);
+        }
+    }
+
+    void rehash(size_t new_capacity) {
+        std::vector<int8_t> old_ctrl = std::move(ctrl);
+        Slot* old_slots = slots;
+        size_t old_capacity = capacity_;
+
+        ctrl.assign(new_capacity, detail::kEmpty);
+        slots = allocator.allocate(new_capacity);
+        capacity_ = new_capacity;
+        growth_left = maxLoad(new_capacity) - size_;
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] < 0) continue;
+            uint64_t hash = mix(old_slots[i].key);
+            size_t index = findFree(hash);
+            ctrl[index] = static_cast<int8_t>(hash & 0x7F);
+            relocate(&slots[index], &old_slots[i]);
+        }
+        if (old_slots) allocator.deallocate(old_slots, old_capacity);
+    }
+
+    void destroyAll() {
+        if constexpr (!std::is_trivially_destructible_v<Slot>) {
+            for (size_t i = 0; i < capacity_; ++i) {
+                if (ctrl[i] >= 0) std::destroy_at(&slots[i]);
+            }
+        }
+    }
+};
+
+// Ключ для примеров и бенчмарков: id пользователя
+struct UserKey {
+    long id = 0;
+    long hash() const { return id; }
+    std::string toString() const { return "UserKey(" + std::to_string(id) + ")"; }
+    void appendTo(FormatBuffer& out) const {
+        out.append("UserKey(");
+        out.append(id);
+        out.append(')');
+    }
+    bool operator==(const UserKey&) const = default;
+};
+
+
+// --- Пакетное хеширование ---
+// hashBatch(items, hashes): hashes[i] = items[i].hash() для всей пачки - для построения
+// индексов, раскладки по шардам, дедупликации. По умолчанию - по вызову hash() на объект;
+// тип может предоставить статический T::hashBatch, считающий пачку целиком
+// (например, циклом без ветвлений, который компилятор векторизует под SSE2/AVX2/NEON).
+template <typename T>
+concept BatchHashable = ComplexConcept<T> && requires(std::span<const T> items, std::span<long> hashes) {
+    T::hashBatch(items, hashes);
+};
+
+template <ComplexConcept T>
+void hashBatch(std::span<const T> items, std::span<long> hashes) {
+    if (hashes.size() < items.size()) {
+        throw std::invalid_argument("hashBatch: hashes короче items");
+    }
+    if constexpr (BatchHashable<T>) {
+        T::hashBatch(items, hashes.first(items.size()));
+    }
+    else {
+        for (size_t i = 0; i < items.size(); ++i) hashes[i] = items[i].hash();
+    }
+}
+
+// Сессия пользователя на устройстве; hash() перемешивает обе половины (fmix32 из murmur3).
+// hashBatch считает по 8 ключей: сначала 32-битные половины в локальные массивы,
+// затем склейка - оба цикла без ветвлений и векторизуются без интринсиков.
+// В обе половины входят оба поля, так что и при 32-битном long (Windows) хеш годный.
+struct SessionKey {
+    uint32_t user_id = 0;
+    uint32_t device_id = 0;
+
+    static uint32_t fmix32(uint32_t h) {
+        h ^= h >> 16;
+        h *= 0x85ebca6bU;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35U;
+        h ^= h >> 16;
+        return h;
+    }
+    static long combine(uint32_t user, uint32_t device) {
+        uint64_t high = fmix32(user ^ (device * 0x85ebca6bU));
+        uint64_t low = fmix32(device ^ (user * 0x9e3779b9U));
+        return static_cast<long>((high << 32) | low);
+    }
+
+    long hash() const { return combine(user_id, device_id); }
+    std::string toString() const {
+        return "SessionKey(" + std::to_string(user_id) + ", " + std::to_string(device_id) + ")";
+    }
+    bool operator==(const SessionKey&) const = default;
+
+    static void hashBatch(std::span<const SessionKey> items, std::span<long> hashes) {
+        constexpr size_t kLanes = 8;
+        size_t i = 0;
+        for (; i + kLanes <= items.size(); i += kLanes) {
+            uint32_t high[kLanes];
+            uint32_t low[kLanes];
+            for (size_t lane = 0; lane < kLanes; ++lane) {
+                high[lane] = fmix32(items[i + lane].user_id ^ (items[i + lane].device_id * 0x85ebca6bU));
+                low[lane] = fmix32(items[i + lane].device_id ^ (items[i + lane].user_id * 0x9e3779b9U));
+            }
+            for (size_t lane = 0; lane < kLanes; ++lane) {
+                hashes[i + lane] = static_cast<long>((static_cast<uint64_t>(high[lane]) << 32) | low[lane]);
+            }
+        }
+        for (; i < items.size(); ++i) hashes[i] = items[i].hash();
+    }
+};
+
+
+// --- Совершенное хеширование на этапе компиляции ---
+// Для наборов ключей, известных при сборке (команды, статусы, типы сообщений):
+// constexpr-сборщик подбирает seed, при котором все ключи попадают в разные слоты.
+// Таблица целиком вычисляется компилятором, а поиск - одна проба и одно сравнение ключа.
+
+// ComplexConcept, у которого hash() и сравнение вычислимы на этапе компиляции
+template <typename T>
+concept ConstexprComplexConcept = ComplexConcept<T> && std::equality_comparable<T> &&
+    std::default_initializable<T> && requires {
+    typename std::integral_constant<long, T{}.hash()>;
+};
+
+// Строковый ключ для статических таблиц. hash() берет длину и три символа (первый,
+// средний, последний) - этого хватает, чтобы различить короткие имена команд и статусов,
+// и не требует прохода по строке; ключи с одинаковым хешем сборщик не примет
+struct StaticKey {
+    std::string_view text;
+
+    constexpr long hash() const {
+        if (text.empty()) return 0;
+        uint64_t h = text.size();
+        h = h * 0x100000001b3ULL ^ static_cast<unsigned char>(text.front());
+        h = h * 0x100000001b3ULL ^ static_cast<unsigned char>(text[text.size() / 2]);
+        h = h * 0x100000001b3ULL ^ static_cast<unsigned char>(text.back());
+        return static_cast<long>(h);
+    }
+    std::string toString() const { return std::string(text); }
+    constexpr bool operator==(const StaticKey&) const = default;
+};
+
+template <ConstexprComplexConcept K, typename V, size_t N>
+class PerfectHashMap {
+public:
+    static_assert(N > 0, "PerfectHashMap: пустой набор ключей");
+    static constexpr size_t kSlots = std::bit_ceil(N * 2); // Свободные слоты ускоряют подбор seed
+
+    // Подбор seed при компиляции; ключи с одинаковым hash() (в том числе повторы) -
+    // ошибка компиляции, их не разведет никакой seed
+    consteval explicit PerfectHashMap(const std::pair<K, V>(&entries)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = i + 1; j < N; ++j) {
+                if (entries[i].first.hash() == entries[j].first.hash()) throw "PerfectHashMap: одинаковые хеши ключей";
+            }
+        }
+        for (seed = 1;; ++seed) {
+            std::array<bool, kSlots> taken{};
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; ++i) {
+                size_t slot = slotOf(entries[i].first.hash(), seed);
+                collision = taken[slot];
+                taken[slot] = true;
+            }
+            if (!collision) break;
+        }
+        for (size_t i = 0; i < N; ++i) {
+            size_t slot = slotOf(entries[i].first.hash(), seed);
+            keys[slot] = entries[i].first;
+            values[slot] = entries[i].second;
+            used[slot] = true;
+        }
+    }
+
+    constexpr const V* find(const K& key) const {
+        size_t slot = slotOf(key.hash(), seed);
+        return used[slot] && keys[slot] == key ? &values[slot] : nullptr;
+    }
+    constexpr V valueOr(const K& key, V fallback) const {
+        const V* value = find(key);
+        return value ? *value : fallback;
+    }
+    constexpr bool contains(const K& key) const { return find(key) != nullptr; }
+    static constexpr size_t size() { return N; }
+
+private:
+    std::array<K, kSlots> keys{};
+    std::array<V, kSlots> values{};
+    std::array<bool, kSlots> used{};
+    uint64_t seed = 0;
+
+    // Мультипликативное хеширование: старшие биты (hash ^ seed) * золотое сечение
+    static constexpr size_t slotOf(long hash, uint64_t seed) {
+        uint64_t h = (static_cast<uint64_t>(hash) ^ seed) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(h >> (64 - std::countr_zero(kSlots)));
+    }
+};
+
+template <typename K, typename V, size_t N>
+consteval PerfectHashMap<K, V, N> makePerfectHashMap(const std::pair<K, V>(&entries)[N]) {
+    return PerfectHashMap<K, V, N>(entries);
+}
+
+// Статусы пользователей и типы сообщений из серверной части (финал.cpp)
+enum class UserStatus { Unknown, Active, Banned, Disconnected };
+enum class MessageType { Unknown, Public, Private };
+
+constexpr auto kUserStatuses = makePerfectHashMap<StaticKey, UserStatus>({
+    { StaticKey{ "active" }, UserStatus::Active },
+    { StaticKey{ "banned" }, UserStatus::Banned },
+    { StaticKey{ "disconnected" }, UserStatus::Disconnected },
+});
+
+constexpr auto kMessageTypes = makePerfectHashMap<StaticKey, MessageType>({
+    { StaticKey{ "public" }, MessageType::Public },
+    { StaticKey{ "private" }, MessageType::Private },
+});
+
+static_assert(kUserStatuses.valueOr(StaticKey{ "banned" }, UserStatus::Unknown) == UserStatus::Banned);
+static_assert(!kUserStatuses.contains(StaticKey{ "deleted" }));
+static_assert(kMessageTypes.valueOr(StaticKey{ "private" }, MessageType::Unknown) == MessageType::Private);
+
+
+// --- ConcurrentHashSet<K> ---
+// Потокобезопасное множество ключей ComplexConcept. Корзина выбирается по K::hash();
+// в корзине - односвязный список, который читатели обходят без блокировок.
+// Писатели берут мьютекс полосы (stripe) - полоса определяется младшими битами хеша,
+// так что ключ остается в своей полосе при любом размере таблицы. Рост таблицы идет
+// по корзине под мьютексом ее полосы: остальные полосы работают, читатели не ждут вовсе.
+// Удаленные узлы и старые таблицы освобождает EpochDomain, когда их уже никто не читает.
+
+// Эпохи для отложенного освобождения памяти. Читатель на время операции публикует
+// в своем слоте эпоху входа; объект, исключенный из структуры (retire), освобождается,
+// когда все читатели, которые могли его увидеть (вошли не позже исключения), вышли.
+class EpochDomain {
+public:
+    static constexpr size_t kMaxThreads = 256;
+
+    // Защита на время одной операции; вложенные Guard в одном потоке не поддерживаются
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& owner) : domain(owner), slot(threadSlot()) {
+            domain.readers[slot].epoch.store(domain.global_epoch.load(std::memory_order_seq_cst), std::memory_order_relaxed);
+            // Либо сборщик увидит этот слот, либо мы увидим все исключения до его сборки
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() { domain.readers[slot].epoch.store(0, std::memory_order_release); }
+
+    private:
+        EpochDomain& domain;
+        size_t slot;
+    };
+
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    ~EpochDomain() { // Читателей уже нет
+        for (const Retired& item : retired) item.destroy(item.object);
+    }
+
+    // object уже недостижим для новых читателей; удалится через delete
+    template <typename T>
+    void retire(T* object) {
+        std::lock_guard<std::mutex> lock(retired_mutex);
+        retired.push_back({ global_epoch.load(std::memory_order_seq_cst), object, &destroy<T> });
+        collectIfGrown();
+    }
+
+    // То же для пачки объектов (например, всех узлов старой таблицы) с одной сборкой
+    template <typename T>
+    void retireAll(const std::vector<T*>& objects) {
+        std::lock_guard<std::mutex> lock(retired_mutex);
+        uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+        retired.reserve(retired.size() + objects.size());
+        for (T* object : objects) retired.push_back({ epoch, object, &destroy<T> });
+        collectIfGrown();
+    }
+
+private:
+    static constexpr size_t kCollectBatch = 64;
+
+    template <typename T>
+    static void destroy(void* pointer) { delete static_cast<T*>(pointer); }
+
+    struct alignas(64) ReaderSlot { // По кэш-линии на поток: читатели не мешают друг другу
+        std::atomic<uint64_t> epoch{ 0 }; // 0 - поток сейчас не читает
+    };
+    struct Retired {
+        uint64_t epoch;
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::atomic<uint64_t> global_epoch{ 1 };
+    ReaderSlot readers[kMaxThreads];
+    std::mutex retired_mutex;
+    std::vector<Retired> retired;
+    size_t retired_after_collect = 0; // Сколько осталось после прошлой сборки
+
+    // Под retired_mutex. Сборка - по приросту с прошлой сборки, а не по общему числу:
+    // объекты, которые еще читают, не должны запускать сборку на каждом retire
+    void collectIfGrown() {
+        if (retired.size() - retired_after_collect < kCollectBatch) return;
+        collect();
+        retired_after_collect = retired.size();
+    }
+
+    // Под retired_mutex. Читатель с эпохой больше эпохи исключения вошел после него
+    // и объект не видел; освобождается все, что старше самого раннего активного читателя
+    void collect() {
+        global_epoch.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = UINT64_MAX;
+        for (const ReaderSlot& reader : readers) {
+            uint64_t epoch = reader.epoch.load(std::memory_order_acquire);
+            if (epoch != 0) oldest = std::min(oldest, epoch);
+        }
+        auto keep = std::partition(retired.begin(), retired.end(),
+            [&](const Retired& item) { return item.epoch >= oldest; });
+        for (auto it = keep; it != retired.end(); ++it) it->destroy(it->object);
+        retired.erase(keep, retired.end());
+    }
+
+    // Номер потока, общий для всех EpochDomain; освобождается при завершении потока
+    static size_t threadSlot() {
+        struct ThreadSlot {
+            size_t index = 0;
+            ThreadSlot() {
+                for (; index < kMaxThreads; ++index) {
+                    if (!claimed[index].exchange(true, std::memory_order_acq_rel)) return;
+                }
+                throw std::runtime_error("EpochDomain: превышено число потоков");
+            }
+            ~ThreadSlot() { claimed[index].store(false, std::memory_order_release); }
+        };
+        thread_local ThreadSlot slot;
+        return slot.index;
+    }
+
+    inline static std::atomic<bool> claimed[kMaxThreads]{};
+};
+
+template <HashMapKey K>
+class ConcurrentHashSet {
+public:
+    explicit ConcurrentHashSet(size_t initialBuckets = 1024)
+        : table(new Table(std::bit_ceil(std::max(initialBuckets, kStripes)))),
+          bucket_count(table.load(std::memory_order_relaxed)->mask + 1) {
+    }
+    ConcurrentHashSet(const ConcurrentHashSet&) = delete;
+    ConcurrentHashSet& operator=(const ConcurrentHashSet&) = delete;
+
+    ~ConcurrentHashSet() { // Другие потоки уже не обращаются к множеству
+        Table* current = table.load(std::memory_order_relaxed);
+        for (size_t b = 0; b <= current->mask; ++b) {
+            for (Node* node = current->buckets[b].load(std::memory_order_relaxed); node;) {
+                Node* next = node->next.load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+        delete current;
+    }
+
+    // Без блокировок: во время роста читатель переходит из перенесенной корзины в новую таблицу
+    bool contains(const K& key) const {
+        EpochDomain::Guard guard(epochs);
+        uint64_t hash = detail::mixHash(key.hash());
+        const Table* current = table.load(std::memory_order_acquire);
+        for (;;) {
+            Node* node = current->buckets[hash & current->mask].load(std::memory_order_acquire);
+            if (node == moved()) {
+                current = current->next.load(std::memory_order_acquire);
+                continue;
+            }
+            for (; node; node = node->next.load(std::memory_order_acquire)) {
+                if (node->hash == hash && node->key == key) return true;
+            }
+            return false;
+        }
+    }
+
+    bool insert(const K& key) {
+        uint64_t hash = detail::mixHash(key.hash());
+        Stripe& stripe = stripes[hash & (kStripes - 1)];
+        size_t stripe_size = 0;
+        {
+            EpochDomain::Guard guard(epochs);
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            std::atomic<Node*>& head = bucketOf(hash);
+            for (Node* node = head.load(std::memory_order_relaxed); node; node = node->next.load(std::memory_order_relaxed)) {
+                if (node->hash == hash && node->key == key) return false;
+            }
+            head.store(new Node(key, hash, head.load(std::memory_order_relaxed)), std::memory_order_release);
+            stripe_size = stripe.size.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+        growIfNeeded(stripe_size); // Без Guard: иначе узлы, исключенные при переносе, не освободить
+        return true;
+    }
+
+    bool erase(const K& key) {
+        EpochDomain::Guard guard(epochs);
+        uint64_t hash = detail::mixHash(key.hash());
+        Stripe& stripe = stripes[hash & (kStripes - 1)];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        std::atomic<Node*>* link = &bucketOf(hash);
+        for (Node* node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed)) {
+            if (node->hash == hash && node->key == key) {
+                // Читатель, стоящий на узле, дойдет по его next до конца списка
+                link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                stripe.size.fetch_sub(1, std::memory_order_relaxed);
+                epochs.retire(node);
+                return true;
+            }
+            link = &node->next;
+        }
+        return false;
+    }
+
+    size_t size() const { // Приблизительно, если множество меняется
+        size_t total = 0;
+        for (const Stripe& stripe : stripes) total += stripe.size.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    size_t bucketCount() const { return bucket_count.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t kStripes = 64;
+
+    struct Node {
+        K key;
+        uint64_t hash;
+        std::atomic<Node*> next;
+        Node(const K& k, uint64_t h, Node* n) : key(k), hash(h), next(n) {}
+    };
+
+    struct Table {
+        size_t mask;
+        std::unique_ptr<std::atomic<Node*>[]> buckets;
+        std::atomic<Table*> next{ nullptr }; // Таблица, в которую идет перенос
+        explicit Table(size_t bucketCount) : mask(bucketCount - 1), buckets(new std::atomic<Node*>[bucketCount]()) {}
+    };
+
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+        std::atomic<size_t> size{ 0 };
+    };
+
+    std::atomic<Table*> table;
+    std::atomic<size_t> bucket_count; // Размер table без разыменования (таблица может быть уже исключена)
+    Stripe stripes[kStripes];
+    std::atomic<bool> resizing{ false };
+    mutable EpochDomain epochs;
+
+    // Метка перенесенной корзины: ее ключи уже в table->next. Только адрес - узла там нет
+    static Node* moved() {
+        alignas(Node) static char marker[sizeof(Node)];
+        return reinterpret_cast<Node*>(marker);
+    }
+
+    // Под мьютексом полосы hash: перенос этой корзины тоже идет под ним, так что результат стабилен
+    std::atomic<Node*>& bucketOf(uint64_t hash) {
+        Table* current = table.load(std::memory_order_acquire);
+        for (;;) {
+            std::atomic<Node*>& head = current->buckets[hash & current->mask];
+            if (head.load(std::memory_order_acquire) != moved()) return head;
+            current = current->next.load(std::memory_order_acquire);
+        }
+    }
+
+    // Рост вдвое, когда в полосе ключей больше, чем ее доля корзин. Переносит один поток,
+    // по корзине под мьютексом ее полосы; остальные тем временем читают и пишут.
+    // Вызывается вне Guard: таблицы исключает только переносящий поток, так что после
+    // захвата resizing текущая таблица не освободится, а узлы старых корзин защищены
+    // мьютексами полос от erase
+    void growIfNeeded(size_t stripeSize) {
+        if (stripeSize <= bucketCount() / kStripes) return;
+        bool expected = false;
+        if (!resizing.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) return;
+        Table* current = table.load(std::memory_order_acquire);
+        if (stripeSize <= (current->mask + 1) / kStripes) {
+            resizing.store(false, std::memory_order_release);
+            return;
+        }
+
+        Table* grown = new Table((current->mask + 1) * 2);
+        current->next.store(grown, std::memory_order_release);
+        std::vector<Node*> old_nodes;
+        old_nodes.reserve(size());
+        for (size_t b = 0; b <= current->mask; ++b) {
+            std::lock_guard<std::mutex> lock(stripes[b & (kStripes - 1)].mutex);
+            Node* chain = current->buckets[b].load(std::memory_order_relaxed);
+            // Копии, а не перецепление: читатели могут еще обходить старый список
+            for (Node* node = chain; node; node = node->next.load(std::memory_order_relaxed)) {
+                std::atomic<Node*>& head = grown->buckets[node->hash & grown->mask];
+                head.store(new Node(node->key, node->hash, head.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+            }
+            current->buckets[b].store(moved(), std::memory_order_release); // Публикует и копии
+            for (; chain; chain = chain->next.load(std::memory_order_relaxed)) old_nodes.push_back(chain);
+        }
+        table.store(grown, std::memory_order_release);
+        bucket_count.store(grown->mask + 1, std::memory_order_release);
+        epochs.retireAll(old_nodes); // Одна сборка на весь рост, а не на каждые 64 узла
+        epochs.retire(current);
+        resizing.store(false, std::memory_order_release);
+    }
+};
+
+
 // --- Функции, использующие концепт ---
 
 // Шаблонная функция, которая принимает только типы, удовлетворяющие ComplexConcept
 template <ComplexConcept T>
 void processComplexType(const T& obj) {
-    std::cout << "Тип '" << obj.toString() << "' удовлетворяет ComplexConcept." << std::endl;
+    char storage[256];
+    FormatBuffer text(storage);
+    appendFormatted(text, obj); // Один раз и без выделений, если у типа есть appendTo
+    std::cout << "Тип '" << text.view() << "' удовлетворяет ComplexConcept." << std::endl;
     std::cout << " hash: " << obj.hash() << std::endl;
-    std::cout << " toString: " << obj.toString() << std::endl;
+    std::cout << " toString: " << text.view() << std::endl;
 }
 
 // Функция, которая будет использовать концепт для ограничения
@@ -82,7 +971,273 @@ void checkComplexConcept() {
 }
 
 
-int main() {
+// --- Бенчмарки (запуск: --bench [число ключей/записей]) ---
+// ConceptHashMap против std::unordered_map с тем же K::hash(): вставка, поиск
+// существующих ключей в случайном порядке и поиск отсутствующих
+void benchConceptHashMap(size_t count) {
+    struct StdHash {
+        size_t operator()(const UserKey& key) const { return std::hash<long>{}(key.hash()); }
+    };
+
+    std::vector<UserKey> keys(count);
+    for (size_t i = 0; i < count; ++i) keys[i].id = static_cast<long>(i * 2654435761ULL % 4000000007ULL);
+    std::vector<UserKey> lookups = keys;
+    std::shuffle(lookups.begin(), lookups.end(), std::mt19937(42));
+
+    auto measure = [&](const char* label, auto&& body) {
+        auto start = std::chrono::steady_clock::now();
+        long checksum = body();
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        std::cout << "  " << label << ": " << elapsed.count() / count << " нс/операция (" << checksum << ")" << std::endl;
+    };
+
+    std::cout << "ConceptHashMap, " << count << " ключей:" << std::endl;
+    {
+        ConceptHashMap<UserKey, long> map;
+        measure("вставка        ", [&] { for (const UserKey& key : keys) map[key] = key.id; return static_cast<long>(map.size()); });
+        measure("поиск (есть)   ", [&] { long sum = 0; for (const UserKey& key : lookups) sum += *map.find(key); return sum; });
+        measure("поиск (нет)    ", [&] { long hits = 0; for (const UserKey& key : lookups) hits += map.contains(UserKey{ key.id + 1 }); return hits; });
+    }
+
+    std::cout << "std::unordered_map, " << count << " ключей:" << std::endl;
+    {
+        std::unordered_map<UserKey, long, StdHash> map;
+        measure("вставка        ", [&] { for (const UserKey& key : keys) map[key] = key.id; return static_cast<long>(map.size()); });
+        measure("поиск (есть)   ", [&] { long sum = 0; for (const UserKey& key : lookups) sum += map.find(key)->second; return sum; });
+        measure("поиск (нет)    ", [&] { long hits = 0; for (const UserKey& key : lookups) hits += map.count(UserKey{ key.id + 1 }); return hits; });
+    }
+}
+// Пакетное хеширование для любого ComplexConcept: скорость hash() по одному и hashBatch,
+// доля различных хешей и хи-квадрат по 1024 корзинам младших и старших бит
+// (для равномерного хеша - около 1023; сильно больше - корзины заполняются неравномерно)
+template <ComplexConcept T>
+void benchHashBatch(const char* name, std::span<const T> items) {
+    std::vector<long> single(items.size());
+    std::vector<long> batch(items.size());
+
+    auto measure = [&](auto&& body) { // Лучший из трех проходов: первый прогревает кэш
+        double best = std::numeric_limits<double>::max();
+        for (int pass = 0; pass < 3; ++pass) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best / items.size();
+    };
+    double single_ns = measure([&] { for (size_t i = 0; i < items.size(); ++i) single[i] = items[i].hash(); });
+    double batch_ns = measure([&] { hashBatch(items, std::span<long>(batch)); });
+    if (single != batch) {
+        std::cout << "  " << name << ": hashBatch расходится с hash()!" << std::endl;
+    }
+
+    constexpr size_t kBuckets = 1024;
+    constexpr int kBits = sizeof(unsigned long) * 8;
+    std::vector<size_t> low(kBuckets);
+    std::vector<size_t> high(kBuckets);
+    for (long hash : batch) {
+        unsigned long h = static_cast<unsigned long>(hash);
+        ++low[h % kBuckets];
+        ++high[h >> (kBits - 10)];
+    }
+    auto chiSquare = [&](const std::vector<size_t>& counts) {
+        double expected = static_cast<double>(items.size()) / kBuckets;
+        double sum = 0;
+        for (size_t count : counts) sum += (count - expected) * (count - expected) / expected;
+        return sum;
+    };
+
+    std::sort(batch.begin(), batch.end());
+    double distinct = static_cast<double>(std::unique(batch.begin(), batch.end()) - batch.begin()) / items.size();
+
+    std::cout << "  " << name << (BatchHashable<T> ? " (свой hashBatch)" : " (hash() по одному)") << ": "
+        << single_ns << " нс/объект по одному, " << batch_ns << " нс/объект пачкой; различных "
+        << distinct * 100 << "%, хи-квадрат младших бит " << std::lround(chiSquare(low))
+        << ", старших " << std::lround(chiSquare(high)) << std::endl;
+}
+
+void benchHashBatches(size_t count) {
+    std::vector<UserKey> users(count);
+    std::vector<SessionKey> sessions(count);
+    for (size_t i = 0; i < count; ++i) {
+        users[i].id = static_cast<long>(i);
+        sessions[i] = SessionKey{ static_cast<uint32_t>(i / 4), static_cast<uint32_t>(i % 4) };
+    }
+    std::cout << "hashBatch, " << count << " объектов:" << std::endl;
+    benchHashBatch<UserKey>("UserKey   ", users);
+    benchHashBatch<SessionKey>("SessionKey", sessions);
+}
+
+// Разбор статуса: таблица с совершенным хешем против цепочки сравнений строк
+void benchPerfectHash(size_t count) {
+    const std::string_view samples[] = { "active", "banned", "disconnected", "deleted" };
+    std::vector<std::string_view> inputs(count);
+    std::mt19937 rng(42);
+    for (std::string_view& input : inputs) input = samples[rng() % 4];
+
+    auto measure = [&](const char* label, auto&& parse) {
+        long checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::string_view input : inputs) checksum += static_cast<long>(parse(input));
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        std::cout << "  " << label << ": " << elapsed.count() / count << " нс/разбор (" << checksum << ")" << std::endl;
+    };
+
+    std::cout << "Разбор статусов, " << count << " строк:" << std::endl;
+    measure("PerfectHashMap ", [](std::string_view input) {
+        return kUserStatuses.valueOr(StaticKey{ input }, UserStatus::Unknown);
+    });
+    measure("сравнения строк", [](std::string_view input) {
+        if (input == "active") return UserStatus::Active;
+        if (input == "banned") return UserStatus::Banned;
+        if (input == "disconnected") return UserStatus::Disconnected;
+        return UserStatus::Unknown;
+    });
+}
+
+// ConcurrentHashSet против std::unordered_set под std::shared_mutex: операций в секунду
+// при 99% чтений / 1% записей и 50% / 50% на 1, 2, 4... потоках (до числа ядер)
+void benchConcurrentHashSet(size_t count) {
+    const long key_range = static_cast<long>(std::max<size_t>(count / 10, 1024));
+    const size_t ops_per_thread = std::max<size_t>(count / 10, 1000);
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    struct LockedSet { // Базовая линия: одна блокировка на все множество
+        std::shared_mutex mutex;
+        std::unordered_set<long> keys;
+        bool contains(const UserKey& key) {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return keys.count(key.id) != 0;
+        }
+        bool insert(const UserKey& key) {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            return keys.insert(key.id).second;
+        }
+        bool erase(const UserKey& key) {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            return keys.erase(key.id) != 0;
+        }
+    };
+
+    auto run = [&](auto& set, unsigned threads, unsigned writePercent) {
+        for (long id = 0; id < key_range; id += 2) set.insert(UserKey{ id }); // Заполнено наполовину
+        std::atomic<long> hits{ 0 };
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 rng(t + 1);
+                long local_hits = 0;
+                for (size_t i = 0; i < ops_per_thread; ++i) {
+                    uint64_t r = rng();
+                    UserKey key{ static_cast<long>(r % key_range) };
+                    unsigned dice = static_cast<unsigned>((r >> 40) % 100);
+                    if (dice >= writePercent) local_hits += set.contains(key);
+                    else if (dice % 2 == 0) local_hits += set.insert(key);
+                    else local_hits += set.erase(key);
+                }
+                hits += local_hits;
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+        return threads * ops_per_thread / elapsed.count() / 1e6;
+    };
+
+    std::cout << "ConcurrentHashSet, " << key_range << " ключей, " << ops_per_thread
+        << " операций на поток (ядер: " << cores << "):" << std::endl;
+    for (unsigned write_percent : { 1u, 50u }) {
+        for (unsigned threads = 1; threads <= cores; threads *= 2) {
+            ConcurrentHashSet<UserKey> concurrent;
+            LockedSet locked;
+            double concurrent_mops = run(concurrent, threads, write_percent);
+            double locked_mops = run(locked, threads, write_percent);
+            std::cout << "  " << 100 - write_percent << "/" << write_percent << ", потоков " << threads << ": "
+                << concurrent_mops << " млн оп/с против " << locked_mops << " у unordered_set + shared_mutex" << std::endl;
+        }
+    }
+}
+
+// Счетчик выделений памяти через замену глобального operator new
+static std::atomic<size_t> allocation_count{ 0 };
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC не видит, что new выше - это malloc
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+// Запись лога с appendTo и такая же запись только с toString()
+struct LogRecord {
+    long id = 0;
+    long hash() const { return id; }
+    std::string toString() const { return "LogRecord(id=" + std::to_string(id) + ", status=active)"; }
+    void appendTo(FormatBuffer& out) const {
+        out.append("LogRecord(id=");
+        out.append(id);
+        out.append(", status=active)");
+    }
+};
+
+struct LegacyLogRecord {
+    long id = 0;
+    long hash() const { return id; }
+    std::string toString() const { return "LogRecord(id=" + std::to_string(id) + ", status=active)"; }
+};
+
+// FormatLogger в нулевое устройство: записей в секунду и выделений памяти на запись
+void benchFormatLogger(size_t count) {
+#ifdef _WIN32
+    std::FILE* null_sink = std::fopen("NUL", "wb");
+#else
+    std::FILE* null_sink = std::fopen("/dev/null", "wb");
+#endif
+    if (!null_sink) {
+        std::cout << "FormatLogger: нет нулевого устройства, бенчмарк пропущен" << std::endl;
+        return;
+    }
+
+    auto measure = [&](const char* label, auto record) {
+        FormatLogger logger(null_sink);
+        size_t allocations_before = allocation_count;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            record.id = static_cast<long>(i);
+            logger.log(record);
+        }
+        logger.flush();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+        double allocations = static_cast<double>(allocation_count - allocations_before) / count;
+        std::cout << "  " << label << ": " << static_cast<long>(count / elapsed.count()) << " записей/с, "
+            << allocations << " выделений/запись" << std::endl;
+    };
+
+    std::cout << "FormatLogger, " << count << " записей:" << std::endl;
+    measure("appendTo       ", LogRecord{});
+    measure("toString       ", LegacyLogRecord{});
+    std::fclose(null_sink);
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        size_t count = argc > 2 ? std::stoull(argv[2]) : 10000000;
+        benchConceptHashMap(count);
+        benchFormatLogger(count);
+        benchHashBatches(count);
+        benchPerfectHash(count);
+        benchConcurrentHashSet(count);
+        return 0;
+    }
+
     // Тестируем с различными типами
 
     std::cout << "--- Тестирование ComplexConcept ---" << std::endl;
@@ -113,5 +1268,64 @@ int main() {
     // processComplexType(NoHash{}); // Это вызвало бы ошибку компиляции, если бы не if constexpr
     // processComplexType(WrongHashReturnType{}); // То же самое
 
+    std::cout << "\n--- Тестирование ConceptHashMap ---" << std::endl;
+    ConceptHashMap<UserKey, std::string> names;
+    for (long id = 1; id <= 1000; ++id) {
+        names[UserKey{ id }] = "User " + std::to_string(id);
+    }
+    names.erase(UserKey{ 500 });
+    std::cout << "Размер: " << names.size() << ", емкость: " << names.capacity() << std::endl; // Ожидаем 999
+    std::cout << "UserKey(42): " << *names.find(UserKey{ 42 }) << std::endl; // Ожидаем "User 42"
+    std::cout << "UserKey(500) найден: " << std::boolalpha << names.contains(UserKey{ 500 }) << std::endl; // Ожидаем false
+    // ConceptHashMap<ValidType, int> invalid; // Ошибка компиляции: у ValidType нет operator==
+
+    std::cout << "\n--- Тестирование hashBatch ---" << std::endl;
+    const SessionKey sessions[] = { { 1, 1 }, { 1, 2 }, { 2, 1 } };
+    long session_hashes[3];
+    hashBatch<SessionKey>(sessions, session_hashes);
+    std::cout << "Совпадает с hash(): " << std::boolalpha
+        << (session_hashes[0] == sessions[0].hash() && session_hashes[2] == sessions[2].hash()) << std::endl; // Ожидаем true
+
+    std::cout << "\n--- Тестирование PerfectHashMap ---" << std::endl;
+    std::string input = "disconnected"; // Строка, известная только при выполнении
+    std::cout << "'" << input << "' -> " << static_cast<int>(kUserStatuses.valueOr(StaticKey{ input }, UserStatus::Unknown))
+        << ", 'public' найден: " << kMessageTypes.contains(StaticKey{ "public" }) << std::endl; // Ожидаем 3 и true
+
+    std::cout << "\n--- Тестирование ConcurrentHashSet ---" << std::endl;
+    {
+        ConcurrentHashSet<UserKey> online(64);
+        std::vector<std::thread> writers;
+        for (long t = 0; t < 4; ++t) {
+            writers.emplace_back([&online, t] {
+                for (long id = t; id < 20000; id += 4) online.insert(UserKey{ id });
+                for (long id = t; id < 20000; id += 8) online.erase(UserKey{ id });
+            });
+        }
+        for (std::thread& writer : writers) writer.join();
+        std::cout << "Размер: " << online.size() << ", корзин: " << online.bucketCount() // Ожидаем 10000
+            << ", UserKey(5) есть: " << online.contains(UserKey{ 5 }) << ", UserKey(1) есть: " << online.contains(UserKey{ 1 })
+            << std::endl; // Ожидаем true и false: удалены id с остатком 0..3 от деления на 8
+    }
+
+    std::cout << "\n--- Тестирование FormatLogger ---" << std::endl;
+    {
+        FormatLogger logger(stdout);
+        logger.log(UserKey{ 7 });  // Через appendTo: "UserKey(7)"
+        logger.log(ValidType{});   // Через toString(): "ValidType"
+    }
+    if (std::FILE* file = std::tmpfile()) {
+        {
+            FormatLogger logger(file, 11); // "UserKey(7)\n" заполняет буфер ровно
+            logger.log(UserKey{ 7 });
+            logger.log(UserKey{ 8 });      // Должна уйти в файл после сброса, а не за конец буфера
+        }
+        char written[32] = {};
+        std::rewind(file);
+        size_t length = std::fread(written, 1, sizeof(written) - 1, file);
+        std::cout << "Заполненный буфер сбрасывается: " << std::boolalpha
+            << (std::string_view(written, length) == "UserKey(7)\nUserKey(8)\n") << std::endl; // Ожидаем true
+        std::fclose(file);
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -6,6 +6,28 @@
 #include <functional> // Для std::bind
 #include <algorithm> // Для std::sort, std::is_sorted
 #include <map>        // Для MyDatabase
+#include <optional>
+#include <span>       // Для пакетных запросов
+#include <chrono>
+#include <thread>     // Для имитации задержки БД
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <unordered_map> // Для CachingDatabase
+#include <coroutine>     // Для асинхронного интерфейса БД
+#include <future>
+#include <queue>
+#include <deque>
+#include <new>       // Для счетчика выделений памяти в тестах
+#include <cstdlib>
+#include <condition_variable>
+#include <exception>
+#include <string_view>
+#include <cstdint>
+#include <limits>
+#include <random>    // Для микробенчмарков
+#include <fstream>   // Для базовой линии тестов производительности
+#include <sstream>
 
 // --- Google Test и Google Mock ---
 // Импортируем их прямо в этот файл для простоты.
@@ -14,6 +36,64 @@
 #include "gmock/gmock.h"
 
 // --- 1. IDatabase.h ---
+// Пользователь не найден (в отличие от прочих ошибок БД, например отсутствия подключения)
+class UserNotFoundError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Закрепление данных бэкенда для чтения без копирования.
+// Пока ReadPin жив, все string_view, полученные с ним, действительны: бэкенд
+// не освобождает замененные или перемещенные данные, пока есть закрепления,
+// и освобождает их при снятии последнего. Бэкенд, который не хранит данные сам,
+// копирует строку в ReadPin - гарантия та же, но без экономии на выделениях.
+// ReadPin используется с одним бэкендом, в одном потоке и не должен его переживать.
+class ReadPin {
+public:
+    // Бэкенд, умеющий откладывать освобождение данных
+    class Source {
+    public:
+        virtual void pin() = 0;
+        virtual void unpin() = 0;
+
+    protected:
+        ~Source() = default;
+    };
+
+    ReadPin() = default;
+    ReadPin(const ReadPin&) = delete;
+    ReadPin& operator=(const ReadPin&) = delete;
+    ~ReadPin() { release(); }
+
+    // Закрепляет source при первом чтении; дальше чтения с этим ReadPin ничего не стоят
+    void attach(Source& source) {
+        if (owner == &source) return;
+        if (owner) {
+            throw std::logic_error("ReadPin: Уже закреплен за другим бэкендом.");
+        }
+        source.pin();
+        owner = &source;
+    }
+
+    // Копия для бэкендов без собственного хранения; deque не перемещает элементы
+    std::string_view keep(std::string value) {
+        return copies.emplace_back(std::move(value));
+    }
+
+    // Снимает закрепление; ранее выданные string_view становятся недействительными
+    void release() {
+        if (owner) {
+            owner->unpin();
+            owner = nullptr;
+        }
+        copies.clear();
+    }
+
+private:
+    Source* owner = nullptr;
+    std::deque<std::string> copies;
+};
+
 // Абстрактный базовый класс для работы с базой данных
 class IDatabase {
 public:
@@ -35,16 +115,133 @@ public:
     // Выполнение SQL-запроса, возвращающего одну запись (например, пользователя)
     virtual User getUserById(int id) = 0;
 
+    // Пакетный запрос пользователей: результат выровнен по ids, для отсутствующих - std::nullopt.
+    // Реализация по умолчанию - по одному getUserById на id (N обращений к БД);
+    // бэкенды, умеющие выбирать пачкой, переопределяют ее одним обращением.
+    virtual std::vector<std::optional<User>> getUsersByIds(std::span<const int> ids) {
+        std::vector<std::optional<User>> users;
+        users.reserve(ids.size());
+        for (int id : ids) {
+            try {
+                users.emplace_back(getUserById(id));
+            }
+            catch (const UserNotFoundError&) {
+                users.emplace_back(std::nullopt);
+            }
+        }
+        return users;
+    }
+
+    // Имя пользователя без копирования: string_view действителен, пока жив pin
+    // (см. ReadPin); для отсутствующего - std::nullopt. Реализация по умолчанию
+    // копирует имя из getUserById в pin; бэкенды с данными в памяти отдают
+    // string_view в свое хранилище, и на попадании не выделяют память вовсе.
+    virtual std::optional<std::string_view> getUserNameView(int id, ReadPin& pin) {
+        try {
+            return pin.keep(std::move(getUserById(id).name));
+        }
+        catch (const UserNotFoundError&) {
+            return std::nullopt;
+        }
+    }
+
+    // Имя пользователя, если бэкенд уже держит его в своем кэше; std::nullopt - нужен
+    // обычный запрос. Отказ ничего не стоит: реализация по умолчанию кэша не имеет
+    virtual std::optional<std::string> getCachedUserName(int id) {
+        (void)id;
+        return std::nullopt;
+    }
+
     // Пример другого запроса, возвращающего, например, количество строк
     virtual int countUsers() = 0;
+
+    // Порция сканирования: до batchSize пользователей с id >= fromId по возрастанию id.
+    // batch очищается и заполняется заново (его память переиспользуется между порциями),
+    // возвращается число строк; меньше batchSize - данных больше нет.
+    // Один вызов на порцию, а не на строку - обходить всех пользователей удобнее через UserScan.
+    virtual size_t scanUsers(int fromId, size_t batchSize, std::vector<User>& batch) = 0;
+};
+
+// Обход всех пользователей порциями: for (const IDatabase::User& user : UserScan(db)).
+// В памяти одновременно не больше одной порции, независимо от размера таблицы.
+class UserScan {
+public:
+    explicit UserScan(IDatabase& database, int fromId = 0, size_t batchSize = 4096)
+        : db(database), next_id(fromId), batch_size(std::max<size_t>(batchSize, 1)) {
+    }
+
+    class iterator {
+    public:
+        using value_type = IDatabase::User;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(UserScan* owner) : scan(owner) {}
+
+        const IDatabase::User& operator*() const { return scan->batch[scan->position]; }
+        const IDatabase::User* operator->() const { return &scan->batch[scan->position]; }
+        iterator& operator++() {
+            scan->advance();
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return scan->finished(); }
+
+    private:
+        UserScan* scan = nullptr;
+    };
+
+    iterator begin() { // Однопроходный: begin() вызывается один раз
+        fetch();
+        return iterator(this);
+    }
+    std::default_sentinel_t end() const { return {}; }
+
+    size_t batchCapacity() const { return batch.capacity(); }
+
+private:
+    IDatabase& db;
+    int next_id;
+    size_t batch_size;
+    std::vector<IDatabase::User> batch;
+    size_t position = 0;
+    bool last_batch = false;
+
+    void fetch() {
+        position = 0;
+        if (last_batch) {
+            batch.clear();
+            return;
+        }
+        size_t count = db.scanUsers(next_id, batch_size, batch);
+        if (count < batch_size || batch.back().id == INT32_MAX) {
+            last_batch = true; // Лишний вызов, который вернет пустую порцию, не нужен
+        }
+        else {
+            next_id = batch.back().id + 1;
+        }
+    }
+
+    void advance() {
+        if (++position >= batch.size()) fetch();
+    }
+
+    bool finished() const { return position >= batch.size(); }
 };
 
 // --- 2. MyDatabase.h / .cpp (Имитация реальной БД) ---
-class MyDatabase : public IDatabase {
+class MyDatabase : public IDatabase, public ReadPin::Source {
 private:
     bool connected = false;
     std::map<int, User> users_db; // Имитация таблицы пользователей
 
+    // Узлы std::map не перемещаются, поэтому string_view в них живут до замены записи;
+    // замененные при закреплениях узлы откладываются до снятия последнего.
+    // Как и остальной класс, без синхронизации: addUser, чтения и снятие закреплений
+    // должны выполняться в одном потоке (или под внешней блокировкой)
+    size_t pins = 0;
+    std::vector<std::map<int, User>::node_type> retired;
+
 public:
     MyDatabase() {
         // Заполним имитационную базу данными при создании
@@ -53,6 +250,19 @@ public:
         users_db[3] = { 3, "Charlie Brown", "charlie@example.com" };
     }
 
+    void addUser(const User& user) {
+        if (pins > 0) {
+            auto node = users_db.extract(user.id);
+            if (node) retired.push_back(std::move(node));
+        }
+        users_db[user.id] = user;
+    }
+
+    void pin() override { ++pins; }
+    void unpin() override {
+        if (--pins == 0) retired.clear();
+    }
+
     bool connect(const std::string& connection_string) override {
         //std::cout << "MyDatabase: Подключение с '" << connection_string << "'..." << std::endl;
         if (connection_string.empty()) {
@@ -79,7 +289,35 @@ public:
         if (it != users_db.end()) {
             return it->second;
         }
-        throw std::runtime_error("MyDatabase: Пользователь с id=" + std::to_string(id) + " не найден.");
+        throw UserNotFoundError("MyDatabase: Пользователь с id=" + std::to_string(id) + " не найден.");
+    }
+
+    std::optional<std::string_view> getUserNameView(int id, ReadPin& pin) override {
+        if (!connected) {
+            throw std::runtime_error("MyDatabase: Не подключено.");
+        }
+        auto it = users_db.find(id);
+        if (it == users_db.end()) return std::nullopt;
+        pin.attach(*this);
+        return std::string_view(it->second.name);
+    }
+
+    std::vector<std::optional<User>> getUsersByIds(std::span<const int> ids) override {
+        if (!connected) {
+            throw std::runtime_error("MyDatabase: Не подключено.");
+        }
+        std::vector<std::optional<User>> users;
+        users.reserve(ids.size());
+        for (int id : ids) {
+            auto it = users_db.find(id);
+            if (it != users_db.end()) {
+                users.emplace_back(it->second);
+            }
+            else {
+                users.emplace_back(std::nullopt);
+            }
+        }
+        return users;
     }
 
     int countUsers() override {
@@ -88,12 +326,496 @@ public:
         }
         return users_db.size();
     }
+
+    size_t scanUsers(int fromId, size_t batchSize, std::vector<User>& batch) override {
+        if (!connected) {
+            throw std::runtime_error("MyDatabase: Не подключено.");
+        }
+        batch.clear();
+        for (auto it = users_db.lower_bound(fromId); it != users_db.end() && batch.size() < batchSize; ++it) {
+            batch.push_back(it->second);
+        }
+        return batch.size();
+    }
+};
+
+// --- 3. FlatDatabase.h ---
+// Хранилище для плотных целочисленных id: массив дескрипторов, индексируемый
+// прямо по id, и все строки в одной непрерывной арене. Дескриптор - 8 байт
+// (смещение в арене и длины имени и email, которые лежат подряд), так что поиск -
+// одно обращение к массиву и одно к арене, без обхода дерева и указателей на строки.
+// При разреженных id массив растет до максимального id - для них подходит MyDatabase.
+// Строки в арене не перезаписываются (замена дописывает новые байты), а буфер арены
+// при росте во время закреплений (ReadPin) откладывается, так что string_view из
+// getUserNameView остаются действительными после последующих addUser.
+// Класс не потокобезопасен: один писатель, addUser не выполняется одновременно
+// с чтениями и снятием закреплений (нужна внешняя блокировка).
+class FlatDatabase : public IDatabase, public ReadPin::Source {
+private:
+    struct Slot {
+        uint32_t offset = kAbsent; // Начало имени в арене; email - сразу за ним
+        uint16_t name_length = 0;
+        uint16_t email_length = 0;
+    };
+    static constexpr uint32_t kAbsent = UINT32_MAX;
+
+    bool connected = false;
+    std::vector<Slot> slots; // Индекс - id пользователя
+    std::vector<char> arena;
+    int user_count = 0;
+    size_t pins = 0;
+    std::vector<std::vector<char>> retired; // Прежние буферы арены, на которые могут ссылаться читатели
+
+    const Slot* find(int id) const {
+        if (id < 0 || static_cast<size_t>(id) >= slots.size()) return nullptr;
+        const Slot& slot = slots[id];
+        return slot.offset == kAbsent ? nullptr : &slot;
+    }
+
+    void checkConnected() const {
+        if (!connected) {
+            throw std::runtime_error("FlatDatabase: Не подключено.");
+        }
+    }
+
+    User makeUser(int id, const Slot& slot) const {
+        const char* name = arena.data() + slot.offset;
+        return { id, std::string(name, slot.name_length), std::string(name + slot.name_length, slot.email_length) };
+    }
+
+public:
+    FlatDatabase() {
+        addUser({ 1, "Alice Smith", "alice@example.com" });
+        addUser({ 2, "Bob Johnson", "bob@example.com" });
+        addUser({ 3, "Charlie Brown", "charlie@example.com" });
+    }
+
+    // Предварительное выделение под userCount пользователей со средней длиной строк bytesPerUser
+    void reserve(size_t userCount, size_t bytesPerUser = 32) {
+        slots.reserve(userCount + 1);
+        arena.reserve(userCount * bytesPerUser);
+    }
+
+    // Повторное добавление того же id заменяет запись; старые байты остаются в арене
+    void addUser(const User& user) {
+        if (user.id < 0) {
+            throw std::invalid_argument("FlatDatabase: Отрицательный id.");
+        }
+        if (user.name.size() > UINT16_MAX || user.email.size() > UINT16_MAX ||
+            arena.size() + user.name.size() + user.email.size() > kAbsent) {
+            throw std::length_error("FlatDatabase: Слишком длинные данные пользователя.");
+        }
+        if (static_cast<size_t>(user.id) >= slots.size()) {
+            slots.resize(user.id + 1);
+        }
+        size_t needed = arena.size() + user.name.size() + user.email.size();
+        if (needed > arena.capacity() && pins > 0) {
+            // Рост переместил бы байты из-под закрепленных string_view: копируем в новый буфер
+            std::vector<char> grown;
+            grown.reserve(std::max(needed, arena.capacity() * 2));
+            grown.assign(arena.begin(), arena.end());
+            retired.push_back(std::move(arena));
+            arena = std::move(grown);
+        }
+        Slot& slot = slots[user.id];
+        if (slot.offset == kAbsent) ++user_count;
+        slot.offset = static_cast<uint32_t>(arena.size());
+        slot.name_length = static_cast<uint16_t>(user.name.size());
+        slot.email_length = static_cast<uint16_t>(user.email.size());
+        arena.insert(arena.end(), user.name.begin(), user.name.end());
+        arena.insert(arena.end(), user.email.begin(), user.email.end());
+    }
+
+    // Имя без копирования; действительно до следующего addUser
+    std::optional<std::string_view> nameView(int id) const {
+        checkConnected();
+        const Slot* slot = find(id);
+        if (!slot) return std::nullopt;
+        return std::string_view(arena.data() + slot->offset, slot->name_length);
+    }
+
+    void pin() override { ++pins; }
+    void unpin() override {
+        if (--pins == 0) retired.clear();
+    }
+
+    size_t retiredBuffers() const { return retired.size(); }
+
+    std::optional<std::string_view> getUserNameView(int id, ReadPin& pin) override {
+        checkConnected();
+        const Slot* slot = find(id);
+        if (!slot) return std::nullopt;
+        pin.attach(*this);
+        return std::string_view(arena.data() + slot->offset, slot->name_length);
+    }
+
+    bool connect(const std::string& connection_string) override {
+        connected = !connection_string.empty();
+        return connected;
+    }
+
+    void disconnect() override {
+        connected = false;
+    }
+
+    User getUserById(int id) override {
+        checkConnected();
+        const Slot* slot = find(id);
+        if (!slot) {
+            throw UserNotFoundError("FlatDatabase: Пользователь с id=" + std::to_string(id) + " не найден.");
+        }
+        return makeUser(id, *slot);
+    }
+
+    std::vector<std::optional<User>> getUsersByIds(std::span<const int> ids) override {
+        checkConnected();
+        std::vector<std::optional<User>> users;
+        users.reserve(ids.size());
+        for (int id : ids) {
+            const Slot* slot = find(id);
+            if (slot) {
+                users.emplace_back(makeUser(id, *slot));
+            }
+            else {
+                users.emplace_back(std::nullopt);
+            }
+        }
+        return users;
+    }
+
+    int countUsers() override {
+        checkConnected();
+        return user_count;
+    }
+
+    // Последовательный проход по массиву дескрипторов и арене
+    size_t scanUsers(int fromId, size_t batchSize, std::vector<User>& batch) override {
+        checkConnected();
+        batch.clear();
+        for (size_t id = std::max(fromId, 0); id < slots.size() && batch.size() < batchSize; ++id) {
+            if (slots[id].offset != kAbsent) {
+                batch.push_back(makeUser(static_cast<int>(id), slots[id]));
+            }
+        }
+        return batch.size();
+    }
 };
 
-// --- 3. UserManager.h / .cpp ---
+// --- 4. CachingDatabase.h ---
+// Кэширующий декоратор: читает пользователей через LRU-кэш по id и кэширует countUsers().
+// Кэш разбит на шарды со своими мьютексами, поэтому его могут разделять много потоков;
+// обращения к внутренней БД делаются без блокировок (она должна быть потокобезопасной сама).
+// Изменения в БД кэш сам не видит: для них есть TTL и явная инвалидация.
+// Загрузка, начатая до инвалидации записи, результат в кэш не кладет: у каждого id с идущими
+// загрузками есть версия, которую invalidate увеличивает, и store сверяет ее с версией на старте.
+class CachingDatabase : public IDatabase {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using Clock = std::function<TimePoint()>; // Подменяется в тестах TTL
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    // capacity - общий предел записей (не меньше 1): делится между шардами без округления
+    // вверх, шардов не больше capacity, так что size() никогда его не превышает;
+    // ttl == 0 - записи не устаревают, пока их не вытеснят или не инвалидируют
+    CachingDatabase(std::unique_ptr<IDatabase> inner, size_t capacity,
+        std::chrono::milliseconds ttl = std::chrono::milliseconds::zero(),
+        size_t shard_count = 16, Clock clock = std::chrono::steady_clock::now)
+        : inner(std::move(inner)), ttl(ttl), clock(std::move(clock)),
+          shards(std::clamp<size_t>(shard_count, 1, std::max<size_t>(capacity, 1))) {
+        capacity = std::max<size_t>(capacity, 1);
+        for (size_t i = 0; i < shards.size(); ++i) {
+            shards[i].capacity = capacity / shards.size() + (i < capacity % shards.size() ? 1 : 0);
+        }
+    }
+
+    bool connect(const std::string& connection_string) override {
+        return inner->connect(connection_string);
+    }
+
+    void disconnect() override {
+        inner->disconnect();
+        invalidateAll(); // После переподключения данные могут быть другими
+    }
+
+    User getUserById(int id) override {
+        uint64_t version = 0;
+        if (std::optional<User> cached = lookup(id, version)) {
+            return *cached;
+        }
+        User user;
+        try {
+            user = inner->getUserById(id); // UserNotFoundError не кэшируется
+        }
+        catch (...) {
+            store(id, version, nullptr);
+            throw;
+        }
+        store(id, version, &user);
+        return user;
+    }
+
+    std::vector<std::optional<User>> getUsersByIds(std::span<const int> ids) override {
+        std::vector<std::optional<User>> users;
+        users.reserve(ids.size());
+        std::vector<int> missing;
+        std::vector<size_t> missing_positions;
+        std::vector<uint64_t> missing_versions;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            uint64_t version = 0;
+            users.push_back(lookup(ids[i], version));
+            if (!users.back()) {
+                missing.push_back(ids[i]);
+                missing_positions.push_back(i);
+                missing_versions.push_back(version);
+            }
+        }
+        if (missing.empty()) {
+            return users;
+        }
+
+        // Промахи - одним пакетным запросом
+        std::vector<std::optional<User>> loaded;
+        try {
+            loaded = inner->getUsersByIds(missing);
+        }
+        catch (...) {
+            for (size_t i = 0; i < missing.size(); ++i) store(missing[i], missing_versions[i], nullptr);
+            throw;
+        }
+        for (size_t i = 0; i < missing.size(); ++i) {
+            const User* user = i < loaded.size() && loaded[i] ? &*loaded[i] : nullptr;
+            store(missing[i], missing_versions[i], user);
+            if (user) users[missing_positions[i]] = std::move(loaded[i]);
+        }
+        return users;
+    }
+
+    int countUsers() override {
+        uint64_t version = 0;
+        {
+            std::lock_guard<std::mutex> lock(count_mutex);
+            if (cached_count && !expired(count_expires)) {
+                ++hits;
+                return *cached_count;
+            }
+            version = count_version;
+        }
+        ++misses;
+        int count = inner->countUsers();
+        std::lock_guard<std::mutex> lock(count_mutex);
+        if (count_version == version) { // Иначе запрос начался до invalidateCount
+            cached_count = count;
+            count_expires = expiresAt();
+        }
+        return count;
+    }
+
+    // Только попадание: промах не регистрирует загрузку и не считается (его посчитает getUserById)
+    std::optional<std::string> getCachedUserName(int id) override {
+        Shard& shard = shardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(id);
+        if (it == shard.index.end() || expired(it->second->expires)) {
+            return std::nullopt;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        ++hits;
+        return it->second->user.name;
+    }
+
+    // Сканирование идет мимо кэша: полный обход вытеснил бы из LRU горячие записи
+    size_t scanUsers(int fromId, size_t batchSize, std::vector<User>& batch) override {
+        return inner->scanUsers(fromId, batchSize, batch);
+    }
+
+    // --- Инвалидация ---
+    void invalidate(int id) {
+        Shard& shard = shardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(id);
+        if (it != shard.index.end()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        auto fill = shard.fills.find(id);
+        if (fill != shard.fills.end()) ++fill->second.version; // Идущие загрузки устарели
+    }
+
+    void invalidateCount() {
+        std::lock_guard<std::mutex> lock(count_mutex);
+        cached_count.reset();
+        ++count_version;
+    }
+
+    void invalidateAll() {
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+            for (auto& [id, fill] : shard.fills) ++fill.version;
+        }
+        invalidateCount();
+    }
+
+    Stats stats() const {
+        return { hits.load(), misses.load(), evictions.load() };
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.lru.size();
+        }
+        return total;
+    }
+
+private:
+    struct Entry {
+        User user;
+        TimePoint expires;
+    };
+
+    // Загрузки одного id, идущие мимо кэша; запись живет, пока есть хотя бы одна
+    struct Fill {
+        uint64_t version = 0; // Растет при инвалидации id
+        size_t pending = 0;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru; // В начале - последние использованные
+        std::unordered_map<int, std::list<Entry>::iterator> index;
+        std::unordered_map<int, Fill> fills;
+        size_t capacity = 1;
+    };
+
+    std::unique_ptr<IDatabase> inner;
+    std::chrono::milliseconds ttl;
+    Clock clock;
+    std::vector<Shard> shards;
+
+    std::mutex count_mutex;
+    std::optional<int> cached_count;
+    TimePoint count_expires;
+    uint64_t count_version = 0; // Растет при invalidateCount, как Fill::version
+
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+    std::atomic<uint64_t> evictions{ 0 };
+
+    Shard& shardFor(int id) {
+        // Перемешивание, чтобы последовательные id не попадали в соседние шарды пачками
+        uint32_t h = static_cast<uint32_t>(id) * 2654435761u;
+        return shards[h % shards.size()];
+    }
+
+    TimePoint expiresAt() const {
+        return ttl == std::chrono::milliseconds::zero() ? TimePoint::max() : clock() + ttl;
+    }
+
+    bool expired(TimePoint expires) const {
+        return expires != TimePoint::max() && clock() >= expires;
+    }
+
+    // При промахе регистрирует загрузку id: version нужно передать в store
+    std::optional<User> lookup(int id, uint64_t& version) {
+        Shard& shard = shardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(id);
+        if (it != shard.index.end()) {
+            if (!expired(it->second->expires)) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                ++hits;
+                return it->second->user;
+            }
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        ++misses;
+        Fill& fill = shard.fills[id];
+        ++fill.pending;
+        version = fill.version;
+        return std::nullopt;
+    }
+
+    // Завершает загрузку, начатую lookup; user == nullptr - загрузить не удалось.
+    // Если id инвалидировали после начала загрузки, результат в кэш не попадает
+    void store(int id, uint64_t version, const User* user) {
+        Shard& shard = shardFor(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto fill = shard.fills.find(id);
+        bool fresh = fill->second.version == version;
+        if (--fill->second.pending == 0) shard.fills.erase(fill);
+        if (!user || !fresh) return;
+
+        auto it = shard.index.find(id);
+        if (it != shard.index.end()) {
+            // Другой поток успел загрузить ту же запись
+            it->second->user = *user;
+            it->second->expires = expiresAt();
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return;
+        }
+        shard.lru.push_front({ *user, expiresAt() });
+        shard.index.emplace(id, shard.lru.begin());
+        if (shard.lru.size() > shard.capacity) {
+            shard.index.erase(shard.lru.back().user.id);
+            shard.lru.pop_back();
+            ++evictions;
+        }
+    }
+};
+
+// --- 5. UserManager.h / .cpp ---
 class UserManager {
 private:
     std::unique_ptr<IDatabase> db;
+    std::atomic<bool> connected{ false }; // initialize() прошел успешно
+
+    // Single-flight: одновременные запросы одного id ждут один общий вызов БД
+    // и получают его результат или исключение
+    struct InFlightRequest {
+        std::shared_future<IDatabase::User> result;
+        size_t waiters = 0; // Присоединившиеся запросы, кроме ведущего
+    };
+    std::mutex in_flight_mutex;
+    std::unordered_map<int, InFlightRequest> in_flight;
+
+    IDatabase::User loadUserCoalesced(int userId) {
+        std::optional<std::promise<IDatabase::User>> promise; // Только у ведущего
+        std::shared_future<IDatabase::User> result;
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            auto it = in_flight.find(userId);
+            if (it != in_flight.end()) {
+                result = it->second.result;
+                ++it->second.waiters;
+            }
+            else {
+                result = promise.emplace().get_future().share();
+                in_flight.emplace(userId, InFlightRequest{ result });
+            }
+        }
+
+        if (promise) {
+            try {
+                promise->set_value(db->getUserById(userId));
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+            // Следующий запрос после завершения снова идет в БД (кэшированием занимается CachingDatabase)
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            in_flight.erase(userId);
+        }
+        return result.get(); // Пробрасывает исключение ведущего запроса
+    }
 
 public:
     UserManager(std::unique_ptr<IDatabase> database)
@@ -104,71 +826,577 @@ public:
         if (!db) {
             return false;
         }
-        return db->connect(connection_string);
+        connected = db->connect(connection_string);
+        return connected.load();
+    }
+
+    // Сколько запросов ждут идущий вызов БД для userId, не считая ведущего; 0, если вызова нет
+    size_t coalescedWaiters(int userId) {
+        std::lock_guard<std::mutex> lock(in_flight_mutex);
+        auto it = in_flight.find(userId);
+        return it != in_flight.end() ? it->second.waiters : 0;
     }
 
     std::string getUserName(int userId) {
-        if (!db) {
+        if (!db || !connected) {
             throw std::runtime_error("UserManager: База данных не инициализирована.");
         }
-        try {
-            IDatabase::User user = db->getUserById(userId); // Используем User из IDatabase
-            return user.name;
+        // Попадание в кэш бэкенда отдаем сразу: single-flight нужен только настоящим промахам,
+        // а его promise, shared_future и узел in_flight - это несколько выделений памяти на вызов
+        if (std::optional<std::string> name = db->getCachedUserName(userId)) {
+            return std::move(*name);
         }
-        catch (const std::runtime_error& e) {
-            throw;
+        return loadUserCoalesced(userId).name;
+    }
+
+    // Имя без копирования и выделений памяти, если бэкенд хранит данные сам
+    // (FlatDatabase, MyDatabase); string_view действителен, пока жив pin.
+    // В отличие от getUserName, идет мимо single-flight: ожидание общего результата
+    // само требует выделений, а чтение из памяти объединять незачем.
+    std::string_view getUserNameView(int userId, ReadPin& pin) {
+        if (!db || !connected) {
+            throw std::runtime_error("UserManager: База данных не инициализирована.");
+        }
+        std::optional<std::string_view> name = db->getUserNameView(userId, pin);
+        if (!name) {
+            throw UserNotFoundError("UserManager: Пользователь с id=" + std::to_string(userId) + " не найден.");
+        }
+        return *name;
+    }
+
+    // Имена пользователей по списку id за одно обращение к БД (например, для страницы
+    // сообщений); результат выровнен по userIds, для отсутствующих - std::nullopt
+    std::vector<std::optional<std::string>> getUserNames(std::span<const int> userIds) {
+        if (!db || !connected) {
+            throw std::runtime_error("UserManager: База данных не инициализирована.");
+        }
+        std::vector<std::optional<IDatabase::User>> users = db->getUsersByIds(userIds);
+        std::vector<std::optional<std::string>> names;
+        names.reserve(users.size());
+        for (std::optional<IDatabase::User>& user : users) {
+            if (user) {
+                names.emplace_back(std::move(user->name));
+            }
+            else {
+                names.emplace_back(std::nullopt);
+            }
         }
+        return names;
     }
 
     int getTotalUserCount() {
-        if (!db) {
+        if (!db || !connected) {
             throw std::runtime_error("UserManager: База данных не инициализирована.");
         }
         return db->countUsers();
     }
 
     void shutdown() {
-        if (db) {
+        if (db && connected) {
             db->disconnect();
+            connected = false;
         }
     }
 };
 
-// --- 4. MockDatabase.h ---
+// --- 6. MockDatabase.h ---
 // Используем gmock для создания мок-объекта
 class MockDatabase : public IDatabase {
 public:
     MOCK_METHOD(bool, connect, (const std::string& connection_string), (override));
     MOCK_METHOD(void, disconnect, (), (override));
     MOCK_METHOD(User, getUserById, (int id), (override));
+    MOCK_METHOD(std::vector<std::optional<User>>, getUsersByIds, (std::span<const int> ids), (override));
     MOCK_METHOD(int, countUsers, (), (override));
+    MOCK_METHOD(size_t, scanUsers, (int fromId, size_t batchSize, std::vector<User>& batch), (override));
 };
 
+// --- 7. LatencyDatabase.h ---
+// Фейковая БД с искусственной задержкой на каждое обращение (round trip).
+// Нужна, чтобы в тестах и замерах было видно, сколько обращений к БД стоит операция.
+class LatencyDatabase : public IDatabase {
+private:
+    MyDatabase storage;
+    std::chrono::microseconds latency;
+    std::atomic<int> round_trips{ 0 };
 
-// --- 5. UserManagerTests.cpp ---
-
-// Используем namespace для удобства
-using ::testing::_;       // wildcard для любых аргументов
-using ::testing::Return; // для возвращаемого значения
-using ::testing::Throw;   // для имитации выбрасывания исключения
-using ::testing::Nice;    // Позволяет не определять все методы мока
-using ::testing::DefaultValue; // Можно задать значение по умолчанию для мок-методов
+    void roundTrip() {
+        ++round_trips;
+        std::this_thread::sleep_for(latency);
+    }
 
-// Тестовый набор (Test Suite) для UserManager
-TEST(UserManagerTest, GetUserName_Connected_ReturnsName) {
-    auto mock_db = std::make_unique<MockDatabase>();
+public:
+    explicit LatencyDatabase(std::chrono::microseconds round_trip_latency)
+        : latency(round_trip_latency) {
+    }
 
-    EXPECT_CALL(*mock_db, connect(_))
-        .Times(1)
-        .WillOnce(Return(true));
+    int roundTrips() const { return round_trips; }
 
-    IDatabase::User expected_user = { 1, "Alice Wonderland", "alice@wonderland.com" };
-    EXPECT_CALL(*mock_db, getUserById(1))
-        .Times(1)
-        .WillOnce(Return(expected_user));
+    bool connect(const std::string& connection_string) override {
+        roundTrip();
+        return storage.connect(connection_string);
+    }
 
-    EXPECT_CALL(*mock_db, disconnect())
-        .Times(1);
+    void disconnect() override {
+        storage.disconnect();
+    }
+
+    User getUserById(int id) override {
+        roundTrip();
+        return storage.getUserById(id);
+    }
+
+    std::optional<std::string_view> getUserNameView(int id, ReadPin& pin) override {
+        roundTrip();
+        return storage.getUserNameView(id, pin);
+    }
+
+    std::vector<std::optional<User>> getUsersByIds(std::span<const int> ids) override {
+        roundTrip(); // Вся пачка - одним запросом
+        return storage.getUsersByIds(ids);
+    }
+
+    int countUsers() override {
+        roundTrip();
+        return storage.countUsers();
+    }
+
+    size_t scanUsers(int fromId, size_t batchSize, std::vector<User>& batch) override {
+        roundTrip(); // Порция - одним запросом
+        return storage.scanUsers(fromId, batchSize, batch);
+    }
+};
+
+
+// --- 8. Task.h ---
+// Ленивая корутина-задача: начинает выполняться при co_await, по завершении
+// передает управление ожидающей корутине (симметричная передача, без роста стека).
+// Исключение из тела задачи пробрасывается в точку co_await.
+template <typename T = void>
+class Task;
+
+namespace detail {
+    struct TaskPromiseBase {
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+        std::exception_ptr error;
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+                return finished.promise().continuation;
+            }
+            void await_resume() noexcept {}
+        };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() noexcept { error = std::current_exception(); }
+    };
+
+    template <typename T>
+    struct TaskPromise : TaskPromiseBase {
+        std::optional<T> value;
+
+        Task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+
+        T result() {
+            if (error) std::rethrow_exception(error);
+            return std::move(*value);
+        }
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase {
+        Task<void> get_return_object() noexcept;
+
+        void return_void() noexcept {}
+
+        void result() {
+            if (error) std::rethrow_exception(error);
+        }
+    };
+}
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle; // Запускаем задачу
+    }
+    T await_resume() { return handle.promise().result(); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+    template <typename T>
+    Task<T> TaskPromise<T>::get_return_object() noexcept {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    // Корутина "запустил и забыл": кадр удаляется сам по завершении
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    template <typename T>
+    Detached signalWhenDone(Task<T> task, std::promise<T> result) {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await task;
+                result.set_value();
+            }
+            else {
+                result.set_value(co_await task);
+            }
+        }
+        catch (...) {
+            result.set_exception(std::current_exception());
+        }
+    }
+
+    template <typename T>
+    struct WhenAllState {
+        explicit WhenAllState(size_t count) : remaining(count + 1), results(count) {}
+
+        std::atomic<size_t> remaining; // +1 - сам запуск, чтобы не завершиться раньше времени
+        std::vector<std::optional<T>> results;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;
+    };
+
+    template <typename T>
+    Detached whenAllItem(Task<T> task, WhenAllState<T>& state, size_t index) {
+        try {
+            state.results[index].emplace(co_await task);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(state.error_mutex);
+            if (!state.error) state.error = std::current_exception();
+        }
+        if (--state.remaining == 0) state.continuation.resume();
+    }
+
+    template <typename T>
+    struct WhenAllAwaiter {
+        WhenAllState<T>& state;
+        std::vector<Task<T>>& tasks;
+
+        bool await_ready() const noexcept { return tasks.empty(); }
+        bool await_suspend(std::coroutine_handle<> awaiting) {
+            state.continuation = awaiting;
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                whenAllItem(std::move(tasks[i]), state, i);
+            }
+            return --state.remaining != 0; // false - все задачи уже завершились
+        }
+        void await_resume() noexcept {}
+    };
+}
+
+// Блокирует вызывающий поток до завершения задачи (для main и тестов)
+template <typename T>
+T syncWait(Task<T> task) {
+    std::promise<T> result;
+    std::future<T> future = result.get_future();
+    detail::signalWhenDone(std::move(task), std::move(result));
+    return future.get();
+}
+
+// Запускает все задачи одновременно и ждет их; результаты - в порядке задач.
+// Если какие-то задачи завершились исключением, пробрасывается первое из них.
+template <typename T>
+Task<std::vector<T>> whenAll(std::vector<Task<T>> tasks) {
+    detail::WhenAllState<T> state(tasks.size());
+    co_await detail::WhenAllAwaiter<T>{ state, tasks };
+    if (state.error) std::rethrow_exception(state.error);
+
+    std::vector<T> results;
+    results.reserve(state.results.size());
+    for (std::optional<T>& result : state.results) {
+        results.push_back(std::move(*result));
+    }
+    co_return results;
+}
+
+// --- 9. IoExecutor.h ---
+// Небольшой исполнитель для корутин: пул потоков, очередь готовых корутин
+// и таймеры. Ожидание (sleepFor) не занимает поток - корутина просто
+// возобновляется по сроку, поэтому немного потоков обслуживают тысячи ожиданий.
+// Корутины, не возобновленные к моменту разрушения исполнителя, не завершатся.
+class IoExecutor {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    explicit IoExecutor(size_t thread_count) {
+        for (size_t i = 0; i < std::max<size_t>(thread_count, 1); ++i) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~IoExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    IoExecutor(const IoExecutor&) = delete;
+    IoExecutor& operator=(const IoExecutor&) = delete;
+
+    // co_await executor.schedule() - продолжить на потоке исполнителя
+    auto schedule() {
+        struct ScheduleAwaiter {
+            IoExecutor& executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> coroutine) { executor.post(coroutine); }
+            void await_resume() const noexcept {}
+        };
+        return ScheduleAwaiter{ *this };
+    }
+
+    // co_await executor.sleepFor(d) - возобновиться на потоке исполнителя через d
+    auto sleepFor(std::chrono::steady_clock::duration delay) {
+        struct SleepAwaiter {
+            IoExecutor& executor;
+            TimePoint deadline;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> coroutine) { executor.addTimer(deadline, coroutine); }
+            void await_resume() const noexcept {}
+        };
+        return SleepAwaiter{ *this, std::chrono::steady_clock::now() + delay };
+    }
+
+    void post(std::coroutine_handle<> coroutine) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(coroutine);
+        }
+        wakeup.notify_one();
+    }
+
+private:
+    struct Timer {
+        TimePoint deadline;
+        uint64_t sequence; // Равные сроки - в порядке добавления
+        std::coroutine_handle<> coroutine;
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t next_sequence = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void addTimer(TimePoint deadline, std::coroutine_handle<> coroutine) {
+        bool earliest;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            earliest = timers.empty() || deadline < timers.top().deadline;
+            timers.push({ deadline, next_sequence++, coroutine });
+        }
+        if (earliest) wakeup.notify_one(); // Спящий поток должен пересчитать время ожидания
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            TimePoint now = std::chrono::steady_clock::now();
+            size_t due = 0;
+            while (!timers.empty() && timers.top().deadline <= now) {
+                ready.push_back(timers.top().coroutine);
+                timers.pop();
+                ++due;
+            }
+            if (due > 1) wakeup.notify_all(); // Готовых больше одной - подключаем остальные потоки
+
+            if (!ready.empty()) {
+                std::coroutine_handle<> coroutine = ready.front();
+                ready.pop_front();
+                lock.unlock();
+                coroutine.resume();
+                lock.lock();
+                continue;
+            }
+            if (stopping) return;
+            if (timers.empty()) {
+                wakeup.wait(lock);
+            }
+            else {
+                TimePoint next = timers.top().deadline; // Копия: во время ожидания куча меняется
+                wakeup.wait_until(lock, next);
+            }
+        }
+    }
+};
+
+// --- 10. IAsyncDatabase.h ---
+// Асинхронный вариант IDatabase: методы - корутины, поток не блокируется на время
+// обращения к БД. Параметры передаются по значению: задача ленивая и может
+// выполниться позже, чем живут аргументы вызывающего.
+class IAsyncDatabase {
+public:
+    virtual ~IAsyncDatabase() = default;
+
+    virtual Task<bool> connect(std::string connection_string) = 0;
+    virtual Task<void> disconnect() = 0;
+    virtual Task<IDatabase::User> getUserById(int id) = 0;
+    virtual Task<int> countUsers() = 0;
+};
+
+// --- 11. AsyncUserManager.h ---
+// Асинхронный UserManager: один поток может держать сколько угодно незавершенных
+// запросов (например, whenAll по странице id), ограничение - только сама БД.
+class AsyncUserManager {
+private:
+    std::unique_ptr<IAsyncDatabase> db;
+    std::atomic<bool> connected{ false };
+
+public:
+    AsyncUserManager(std::unique_ptr<IAsyncDatabase> database)
+        : db(std::move(database)) {
+    }
+
+    Task<bool> initialize(std::string connection_string) {
+        if (!db) {
+            co_return false;
+        }
+        connected = co_await db->connect(std::move(connection_string));
+        co_return connected.load();
+    }
+
+    Task<std::string> getUserName(int userId) {
+        if (!db || !connected) {
+            throw std::runtime_error("AsyncUserManager: База данных не инициализирована.");
+        }
+        IDatabase::User user = co_await db->getUserById(userId);
+        co_return std::move(user.name);
+    }
+
+    Task<int> getTotalUserCount() {
+        if (!db || !connected) {
+            throw std::runtime_error("AsyncUserManager: База данных не инициализирована.");
+        }
+        co_return co_await db->countUsers();
+    }
+
+    Task<void> shutdown() {
+        if (db && connected) {
+            co_await db->disconnect();
+            connected = false;
+        }
+    }
+};
+
+// --- 12. AsyncLatencyDatabase.h ---
+// Асинхронная фейковая БД: каждое обращение ждет latency на таймере исполнителя,
+// не занимая поток, затем отвечает из MyDatabase.
+class AsyncLatencyDatabase : public IAsyncDatabase {
+private:
+    IoExecutor& executor;
+    MyDatabase storage; // После connect только читается - безопасно из нескольких потоков
+    std::chrono::microseconds latency;
+    std::atomic<int> round_trips{ 0 };
+
+public:
+    AsyncLatencyDatabase(IoExecutor& io_executor, std::chrono::microseconds round_trip_latency)
+        : executor(io_executor), latency(round_trip_latency) {
+    }
+
+    int roundTrips() const { return round_trips; }
+
+    Task<bool> connect(std::string connection_string) override {
+        ++round_trips;
+        co_await executor.sleepFor(latency);
+        co_return storage.connect(connection_string);
+    }
+
+    Task<void> disconnect() override {
+        co_await executor.schedule();
+        storage.disconnect();
+    }
+
+    Task<IDatabase::User> getUserById(int id) override {
+        ++round_trips;
+        co_await executor.sleepFor(latency);
+        co_return storage.getUserById(id);
+    }
+
+    Task<int> countUsers() override {
+        ++round_trips;
+        co_await executor.sleepFor(latency);
+        co_return storage.countUsers();
+    }
+};
+
+// --- 13. UserManagerTests.cpp ---
+
+// Используем namespace для удобства
+using ::testing::_;       // wildcard для любых аргументов
+using ::testing::Return; // для возвращаемого значения
+using ::testing::Throw;   // для имитации выбрасывания исключения
+using ::testing::NiceMock; // Позволяет не определять все методы мока
+using ::testing::DefaultValue; // Можно задать значение по умолчанию для мок-методов
+using ::testing::ElementsAre; // для проверки содержимого контейнеров
+
+// Тестовый набор (Test Suite) для UserManager
+TEST(UserManagerTest, GetUserName_Connected_ReturnsName) {
+    auto mock_db = std::make_unique<MockDatabase>();
+
+    EXPECT_CALL(*mock_db, connect(_))
+        .Times(1)
+        .WillOnce(Return(true));
+
+    IDatabase::User expected_user = { 1, "Alice Wonderland", "alice@wonderland.com" };
+    EXPECT_CALL(*mock_db, getUserById(1))
+        .Times(1)
+        .WillOnce(Return(expected_user));
+
+    EXPECT_CALL(*mock_db, disconnect())
+        .Times(1);
 
     UserManager manager(std::move(mock_db));
     ASSERT_TRUE(manager.initialize("dummy_connection_string"));
@@ -242,6 +1470,988 @@ TEST(UserManagerTest, GetTotalUserCount_ReturnsCount) {
     manager.shutdown();
 }
 
+TEST(UserManagerTest, GetUserNames_UsesSingleBatchQuery) {
+    auto mock_db = std::make_unique<MockDatabase>();
+
+    EXPECT_CALL(*mock_db, connect(_))
+        .Times(1)
+        .WillOnce(Return(true));
+
+    // Один пакетный запрос вместо запроса на каждый id
+    EXPECT_CALL(*mock_db, getUserById(_)).Times(0);
+    EXPECT_CALL(*mock_db, getUsersByIds(_))
+        .Times(1)
+        .WillOnce([](std::span<const int> ids) {
+            EXPECT_THAT(std::vector<int>(ids.begin(), ids.end()), ElementsAre(1, 99, 2));
+            return std::vector<std::optional<IDatabase::User>>{
+                IDatabase::User{ 1, "Alice", "alice@example.com" },
+                std::nullopt,
+                IDatabase::User{ 2, "Bob", "bob@example.com" } };
+        });
+
+    EXPECT_CALL(*mock_db, disconnect())
+        .Times(1);
+
+    UserManager manager(std::move(mock_db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    const int ids[] = { 1, 99, 2 };
+    std::vector<std::optional<std::string>> names = manager.getUserNames(ids);
+    ASSERT_EQ(names.size(), 3u);
+    ASSERT_EQ(names[0], "Alice");
+    ASSERT_FALSE(names[1].has_value());
+    ASSERT_EQ(names[2], "Bob");
+
+    manager.shutdown();
+}
+
+TEST(UserManagerTest, GetUsersByIds_DefaultFallsBackToSingleLookups) {
+    MockDatabase mock_db;
+
+    // Реализация по умолчанию из IDatabase: по одному getUserById на id
+    EXPECT_CALL(mock_db, getUsersByIds(_))
+        .WillOnce([&mock_db](std::span<const int> ids) { return mock_db.IDatabase::getUsersByIds(ids); });
+    EXPECT_CALL(mock_db, getUserById(1))
+        .WillOnce(Return(IDatabase::User{ 1, "Alice", "alice@example.com" }));
+    EXPECT_CALL(mock_db, getUserById(7))
+        .WillOnce(Throw(UserNotFoundError("User not found in mock")));
+
+    const int ids[] = { 1, 7 };
+    std::vector<std::optional<IDatabase::User>> users = mock_db.getUsersByIds(ids);
+    ASSERT_EQ(users.size(), 2u);
+    ASSERT_EQ(users[0]->name, "Alice");
+    ASSERT_FALSE(users[1].has_value());
+}
+
+TEST(UserManagerTest, GetUserNames_NotConnected_ThrowsException) {
+    UserManager manager(std::make_unique<MyDatabase>());
+    const int ids[] = { 1 };
+    ASSERT_THROW(manager.getUserNames(ids), std::runtime_error);
+}
+
+// Замер: страница из 100 id через getUserName по одному и через getUserNames пачкой
+TEST(UserManagerBenchmark, GetUserNames_BatchSavesRoundTrips) {
+    const std::chrono::microseconds latency(200);
+    auto db = std::make_unique<LatencyDatabase>(latency);
+    LatencyDatabase* fake = db.get();
+    UserManager manager(std::move(db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    std::vector<int> ids;
+    for (int i = 0; i < 100; ++i) ids.push_back(1 + i % 3);
+
+    int trips_before = fake->roundTrips();
+    auto start = std::chrono::steady_clock::now();
+    for (int id : ids) manager.getUserName(id);
+    auto single = std::chrono::steady_clock::now() - start;
+    int single_trips = fake->roundTrips() - trips_before;
+
+    trips_before = fake->roundTrips();
+    start = std::chrono::steady_clock::now();
+    std::vector<std::optional<std::string>> names = manager.getUserNames(ids);
+    auto batch = std::chrono::steady_clock::now() - start;
+    int batch_trips = fake->roundTrips() - trips_before;
+
+    std::cout << "getUserName x" << ids.size() << ": " << single_trips << " round trips, "
+        << std::chrono::duration_cast<std::chrono::microseconds>(single).count() << " us" << std::endl;
+    std::cout << "getUserNames:    " << batch_trips << " round trip, "
+        << std::chrono::duration_cast<std::chrono::microseconds>(batch).count() << " us" << std::endl;
+
+    ASSERT_EQ(names.size(), ids.size());
+    ASSERT_EQ(single_trips, 100);
+    ASSERT_EQ(batch_trips, 1);
+
+    manager.shutdown();
+}
+
+// --- Тесты single-flight в UserManager ---
+// Запускает threads_count потоков, одновременно вызывающих getUserName(userId);
+// whileRunning выполняется в вызывающем потоке, пока запросы идут
+static std::vector<std::exception_ptr> concurrentGetUserName(UserManager& manager, int userId, int threads_count,
+    std::vector<std::string>& names, const std::function<void()>& whileRunning = {}) {
+    std::vector<std::exception_ptr> errors(threads_count);
+    names.assign(threads_count, std::string());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threads_count; ++i) {
+        threads.emplace_back([&, i]() {
+            try {
+                names[i] = manager.getUserName(userId);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    if (whileRunning) whileRunning();
+    for (std::thread& thread : threads) thread.join();
+    return errors;
+}
+
+TEST(UserManagerSingleFlightTest, ConcurrentBurst_OneBackendCall) {
+    auto mock_db = std::make_unique<MockDatabase>();
+    MockDatabase* mock = mock_db.get();
+
+    EXPECT_CALL(*mock, connect(_)).WillOnce(Return(true));
+    // Ответ БД задерживается, пока все потоки не встанут в ожидание
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    EXPECT_CALL(*mock, getUserById(7))
+        .Times(1)
+        .WillOnce([released](int id) {
+            released.wait();
+            return IDatabase::User{ id, "Popular User", "popular@example.com" };
+        });
+    EXPECT_CALL(*mock, disconnect()).Times(1);
+
+    UserManager manager(std::move(mock_db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    std::vector<std::string> names;
+    std::vector<std::exception_ptr> errors = concurrentGetUserName(manager, 7, 32, names, [&]() {
+        while (manager.coalescedWaiters(7) < 31) std::this_thread::yield();
+        release.set_value();
+    });
+    for (int i = 0; i < 32; ++i) {
+        ASSERT_FALSE(errors[i]);
+        ASSERT_EQ(names[i], "Popular User");
+    }
+
+    manager.shutdown();
+}
+
+TEST(UserManagerSingleFlightTest, ConcurrentBurst_SharesException) {
+    auto mock_db = std::make_unique<MockDatabase>();
+    MockDatabase* mock = mock_db.get();
+
+    EXPECT_CALL(*mock, connect(_)).WillOnce(Return(true));
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    EXPECT_CALL(*mock, getUserById(99))
+        .Times(1)
+        .WillOnce([released](int) -> IDatabase::User {
+            released.wait();
+            throw UserNotFoundError("User not found in mock");
+        });
+    EXPECT_CALL(*mock, disconnect()).Times(1);
+
+    UserManager manager(std::move(mock_db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    std::vector<std::string> names;
+    std::vector<std::exception_ptr> errors = concurrentGetUserName(manager, 99, 16, names, [&]() {
+        while (manager.coalescedWaiters(99) < 15) std::this_thread::yield();
+        release.set_value();
+    });
+    for (const std::exception_ptr& error : errors) {
+        ASSERT_TRUE(error);
+        ASSERT_THROW(std::rethrow_exception(error), UserNotFoundError);
+    }
+
+    manager.shutdown();
+}
+
+TEST(UserManagerSingleFlightTest, SequentialLookups_NotCoalesced) {
+    auto mock_db = std::make_unique<MockDatabase>();
+
+    EXPECT_CALL(*mock_db, connect(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_db, getUserById(1))
+        .Times(2) // Завершенный запрос не кэшируется
+        .WillRepeatedly(Return(IDatabase::User{ 1, "Alice", "alice@example.com" }));
+    EXPECT_CALL(*mock_db, disconnect()).Times(1);
+
+    UserManager manager(std::move(mock_db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+    ASSERT_EQ(manager.getUserName(1), "Alice");
+    ASSERT_EQ(manager.getUserName(1), "Alice");
+    manager.shutdown();
+}
+
+// Замер: 64 потока по 50 запросов к трем "популярным" пользователям при задержке БД 1 мс
+TEST(UserManagerSingleFlightBenchmark, HotKeyBurst_ReducesBackendLoad) {
+    auto db = std::make_unique<LatencyDatabase>(std::chrono::microseconds(1000));
+    LatencyDatabase* fake = db.get();
+    UserManager manager(std::move(db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    const int threads_count = 64;
+    const int requests_per_thread = 50;
+    int trips_before = fake->roundTrips();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&manager, t]() {
+            for (int i = 0; i < requests_per_thread; ++i) {
+                manager.getUserName(1 + (t + i) % 3);
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    int requests = threads_count * requests_per_thread;
+    int backend_calls = fake->roundTrips() - trips_before;
+    std::cout << requests << " requests -> " << backend_calls << " backend calls ("
+        << requests / std::max(backend_calls, 1) << "x less), " << elapsed.count() << " ms" << std::endl;
+    ASSERT_LT(backend_calls * 4, requests);
+
+    manager.shutdown();
+}
+
+// --- Тесты FlatDatabase ---
+TEST(FlatDatabaseTest, LookupsMatchMyDatabase) {
+    FlatDatabase flat;
+    MyDatabase reference;
+    ASSERT_FALSE(flat.connect(""));
+    ASSERT_THROW(flat.getUserById(1), std::runtime_error);
+    ASSERT_TRUE(flat.connect("dummy_connection_string"));
+    ASSERT_TRUE(reference.connect("dummy_connection_string"));
+
+    for (int id = 1; id <= 3; ++id) {
+        IDatabase::User expected = reference.getUserById(id);
+        IDatabase::User actual = flat.getUserById(id);
+        ASSERT_EQ(actual.id, expected.id);
+        ASSERT_EQ(actual.name, expected.name);
+        ASSERT_EQ(actual.email, expected.email);
+    }
+    ASSERT_THROW(flat.getUserById(0), UserNotFoundError);
+    ASSERT_THROW(flat.getUserById(1000), UserNotFoundError);
+    ASSERT_THROW(flat.getUserById(-5), UserNotFoundError);
+    ASSERT_EQ(flat.countUsers(), 3);
+    ASSERT_EQ(flat.nameView(2), "Bob Johnson");
+}
+
+TEST(FlatDatabaseTest, AddUserReplacesAndCounts) {
+    FlatDatabase flat;
+    ASSERT_TRUE(flat.connect("dummy_connection_string"));
+    flat.addUser({ 10, "Dave", "" });
+    flat.addUser({ 2, "Robert Johnson", "robert@example.com" });
+    ASSERT_EQ(flat.countUsers(), 4);
+    ASSERT_EQ(flat.getUserById(2).name, "Robert Johnson");
+    ASSERT_EQ(flat.getUserById(10).email, "");
+
+    const int ids[] = { 10, 5, 3 };
+    std::vector<std::optional<IDatabase::User>> users = flat.getUsersByIds(ids);
+    ASSERT_EQ(users[0]->name, "Dave");
+    ASSERT_FALSE(users[1].has_value());
+    ASSERT_EQ(users[2]->name, "Charlie Brown");
+}
+
+// Микробенчмарк: 1M случайных поисков в 1M пользователей, std::map против плоского хранилища
+TEST(FlatDatabaseBenchmark, RandomLookupsAtOneMillionUsers) {
+    const int users_count = 1000000;
+    const int lookups_count = 1000000;
+    MyDatabase map_db;
+    FlatDatabase flat_db;
+    flat_db.reserve(users_count, 24);
+    for (int id = 1; id <= users_count; ++id) {
+        IDatabase::User user{ id, "User " + std::to_string(id), "u" + std::to_string(id) + "@ex.com" };
+        map_db.addUser(user);
+        flat_db.addUser(user);
+    }
+    ASSERT_TRUE(map_db.connect("dummy_connection_string"));
+    ASSERT_TRUE(flat_db.connect("dummy_connection_string"));
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pick(1, users_count);
+    std::vector<int> ids(lookups_count);
+    for (int& id : ids) id = pick(rng);
+
+    auto measure = [&](const char* label, auto&& lookup) {
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int id : ids) checksum += lookup(id);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << label << ": " << elapsed.count() / lookups_count << " ns/lookup" << std::endl;
+        return checksum;
+    };
+
+    size_t map_sum = measure("MyDatabase::getUserById  ", [&](int id) { return map_db.getUserById(id).name.size(); });
+    size_t flat_sum = measure("FlatDatabase::getUserById", [&](int id) { return flat_db.getUserById(id).name.size(); });
+    size_t view_sum = measure("FlatDatabase::nameView   ", [&](int id) { return flat_db.nameView(id)->size(); });
+
+    ASSERT_EQ(map_sum, flat_sum);
+    ASSERT_EQ(map_sum, view_sum);
+    ASSERT_EQ(flat_db.countUsers(), users_count); // Сид-пользователи 1..3 заменены, а не добавлены
+}
+
+// --- Тесты чтения без копирования ---
+// Счетчик выделений памяти через замену глобального operator new
+static std::atomic<size_t> allocation_count{ 0 };
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC не видит, что new выше - это malloc
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+TEST(ZeroCopyReadTest, FlatDatabase_ViewsSurviveWritesWhilePinned) {
+    FlatDatabase flat;
+    ASSERT_TRUE(flat.connect("dummy_connection_string"));
+    {
+        ReadPin pin;
+        std::string_view alice = *flat.getUserNameView(1, pin);
+        ASSERT_FALSE(flat.getUserNameView(42, pin).has_value());
+
+        flat.addUser({ 1, "Alice Cooper", "cooper@example.com" }); // Замена записи
+        for (int id = 100; id < 10000; ++id) {                     // Рост арены
+            flat.addUser({ id, "User " + std::to_string(id), "" });
+        }
+        ASSERT_GT(flat.retiredBuffers(), 0u);
+        ASSERT_EQ(alice, "Alice Smith");
+        ASSERT_EQ(*flat.getUserNameView(1, pin), "Alice Cooper");
+    }
+    ASSERT_EQ(flat.retiredBuffers(), 0u); // Последнее закрепление снято - буферы освобождены
+}
+
+TEST(ZeroCopyReadTest, MyDatabase_ReplacedUserKeptWhilePinned) {
+    MyDatabase db;
+    ASSERT_TRUE(db.connect("dummy_connection_string"));
+    ReadPin pin;
+    std::string_view bob = *db.getUserNameView(2, pin);
+    db.addUser({ 2, "Robert Johnson", "robert@example.com" });
+    ASSERT_EQ(bob, "Bob Johnson");
+    ASSERT_EQ(*db.getUserNameView(2, pin), "Robert Johnson");
+
+    FlatDatabase other;
+    ASSERT_TRUE(other.connect("dummy_connection_string"));
+    ASSERT_THROW(other.getUserNameView(1, pin), std::logic_error);
+}
+
+TEST(ZeroCopyReadTest, DefaultImplementationCopiesIntoPin) {
+    auto mock_db = std::make_unique<NiceMock<MockDatabase>>();
+    EXPECT_CALL(*mock_db, connect(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_db, getUserById(1)).WillOnce(Return(IDatabase::User{ 1, "Alice Smith", "alice@example.com" }));
+    EXPECT_CALL(*mock_db, getUserById(7)).WillOnce(Throw(UserNotFoundError("Пользователь не найден")));
+
+    UserManager manager(std::move(mock_db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+    ReadPin pin;
+    ASSERT_EQ(manager.getUserNameView(1, pin), "Alice Smith");
+    ASSERT_THROW(manager.getUserNameView(7, pin), UserNotFoundError);
+    manager.shutdown();
+    ASSERT_THROW(manager.getUserNameView(1, pin), std::runtime_error);
+}
+
+// Выделений памяти на поиск: getUserName копирует имя и ждет через future,
+// на попадании в CachingDatabase - только копирует имя, getUserNameView не выделяет ничего
+TEST(ZeroCopyReadBenchmark, AllocationsPerLookup) {
+    const int users_count = 100000;
+    const int lookups_count = 100000;
+    auto flat_db = std::make_unique<FlatDatabase>();
+    flat_db->reserve(users_count, 40);
+    for (int id = 1; id <= users_count; ++id) {
+        flat_db->addUser({ id, "User with a long name " + std::to_string(id), "" }); // Длиннее SSO-буфера
+    }
+    UserManager flat_manager(std::move(flat_db));
+    UserManager map_manager(std::make_unique<LatencyDatabase>(std::chrono::microseconds(0)));
+    auto cached_flat_db = std::make_unique<FlatDatabase>();
+    for (int id = 1; id <= 1000; ++id) {
+        cached_flat_db->addUser({ id, "User with a long name " + std::to_string(id), "" });
+    }
+    UserManager cached_manager(std::make_unique<CachingDatabase>(std::move(cached_flat_db), 4096));
+    ASSERT_TRUE(flat_manager.initialize("dummy_connection_string"));
+    ASSERT_TRUE(map_manager.initialize("dummy_connection_string"));
+    ASSERT_TRUE(cached_manager.initialize("dummy_connection_string"));
+    for (int id = 1; id <= 1000; ++id) cached_manager.getUserName(id); // Прогрев кэша
+
+    auto measure = [&](const char* label, int modulo, auto&& lookup) {
+        size_t checksum = 0;
+        size_t before = allocation_count;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups_count; ++i) checksum += lookup(1 + i % modulo);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        double allocations = static_cast<double>(allocation_count - before) / lookups_count;
+        std::cout << label << ": " << allocations << " allocs/lookup, "
+            << elapsed.count() / lookups_count << " ns/lookup" << std::endl;
+        EXPECT_GT(checksum, 0u);
+        return allocations;
+    };
+
+    ReadPin flat_pin;
+    ReadPin map_pin;
+    double copy_allocations = measure("FlatDatabase getUserName    ", users_count,
+        [&](int id) { return flat_manager.getUserName(id).size(); });
+    double cached_allocations = measure("CachingDatabase getUserName ", 1000,
+        [&](int id) { return cached_manager.getUserName(id).size(); });
+    double flat_allocations = measure("FlatDatabase getUserNameView", users_count,
+        [&](int id) { return flat_manager.getUserNameView(id, flat_pin).size(); });
+    double map_allocations = measure("MyDatabase getUserNameView  ", 3,
+        [&](int id) { return map_manager.getUserNameView(id, map_pin).size(); });
+
+    ASSERT_GT(copy_allocations, 1.0);
+    ASSERT_EQ(cached_allocations, 1.0); // Одна копия имени, без promise и узла in_flight
+    ASSERT_EQ(flat_allocations, 0.0);
+    ASSERT_EQ(map_allocations, 0.0);
+}
+
+// --- Тесты UserScan ---
+TEST(UserScanTest, StreamsBatchesFromMock) {
+    MockDatabase mock_db;
+    auto fill = [](std::vector<int> ids) {
+        return [ids](int, size_t, std::vector<IDatabase::User>& batch) {
+            batch.clear();
+            for (int id : ids) batch.push_back({ id, "User " + std::to_string(id), "" });
+            return batch.size();
+        };
+    };
+
+    // Неполная вторая порция означает конец: третьего вызова нет
+    ::testing::InSequence sequence;
+    EXPECT_CALL(mock_db, scanUsers(0, 2, _)).WillOnce(fill({ 1, 2 }));
+    EXPECT_CALL(mock_db, scanUsers(3, 2, _)).WillOnce(fill({ 5 }));
+
+    std::vector<int> seen;
+    for (const IDatabase::User& user : UserScan(mock_db, 0, 2)) {
+        seen.push_back(user.id);
+    }
+    ASSERT_THAT(seen, ElementsAre(1, 2, 5));
+}
+
+TEST(UserScanTest, MyDatabaseAndFlatDatabaseAgree) {
+    MyDatabase map_db;
+    FlatDatabase flat_db;
+    for (int id = 10; id < 1000; id += 7) {
+        IDatabase::User user{ id, "User " + std::to_string(id), "" };
+        map_db.addUser(user);
+        flat_db.addUser(user);
+    }
+    ASSERT_TRUE(map_db.connect("dummy_connection_string"));
+    ASSERT_TRUE(flat_db.connect("dummy_connection_string"));
+
+    std::vector<int> map_ids;
+    std::vector<int> flat_ids;
+    for (const IDatabase::User& user : UserScan(map_db, 2, 16)) map_ids.push_back(user.id);
+    for (const IDatabase::User& user : UserScan(flat_db, 2, 16)) flat_ids.push_back(user.id);
+
+    ASSERT_EQ(map_ids, flat_ids);
+    ASSERT_EQ(map_ids.size(), static_cast<size_t>(map_db.countUsers() - 1)); // Без пользователя 1
+    ASSERT_TRUE(std::is_sorted(map_ids.begin(), map_ids.end()));
+}
+
+TEST(UserScanTest, NotConnected_Throws) {
+    MyDatabase db;
+    UserScan scan(db);
+    ASSERT_THROW(scan.begin(), std::runtime_error);
+}
+
+// Замер: полный обход 4M пользователей FlatDatabase порциями по 4096
+TEST(UserScanBenchmark, StreamsMillionsOfUsersInConstantMemory) {
+    const int users_count = 4000000;
+    FlatDatabase flat_db;
+    flat_db.reserve(users_count, 24);
+    for (int id = 1; id <= users_count; ++id) {
+        flat_db.addUser({ id, "User " + std::to_string(id), "u" + std::to_string(id) + "@ex.com" });
+    }
+    ASSERT_TRUE(flat_db.connect("dummy_connection_string"));
+
+    UserScan scan(flat_db, 0, 4096);
+    size_t rows = 0;
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const IDatabase::User& user : scan) {
+        ++rows;
+        bytes += sizeof(user.id) + user.name.size() + user.email.size();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    double seconds = std::max<long long>(elapsed.count(), 1) / 1e6;
+    std::cout << "Scanned " << rows << " users in " << elapsed.count() / 1000 << " ms: "
+        << static_cast<long long>(rows / seconds) << " rows/s, "
+        << static_cast<long long>(bytes / seconds / (1 << 20)) << " MiB/s of user data" << std::endl;
+
+    ASSERT_EQ(rows, static_cast<size_t>(users_count));
+    ASSERT_LE(scan.batchCapacity(), 4096u); // Память обхода не растет с размером таблицы
+}
+
+// --- Тесты CachingDatabase ---
+TEST(CachingDatabaseTest, GetUserName_RepeatedLookupsHitCache) {
+    auto mock_db = std::make_unique<MockDatabase>();
+    MockDatabase* mock = mock_db.get();
+    auto cache_db = std::make_unique<CachingDatabase>(std::move(mock_db), 100);
+    CachingDatabase* cache = cache_db.get();
+
+    EXPECT_CALL(*mock, connect(_)).WillOnce(Return(true));
+    EXPECT_CALL(*mock, getUserById(1))
+        .Times(1) // Остальные запросы обслуживает кэш
+        .WillOnce(Return(IDatabase::User{ 1, "Alice", "alice@example.com" }));
+    EXPECT_CALL(*mock, countUsers())
+        .Times(1)
+        .WillOnce(Return(5));
+    EXPECT_CALL(*mock, disconnect()).Times(1);
+
+    UserManager manager(std::move(cache_db));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(manager.getUserName(1), "Alice");
+        ASSERT_EQ(manager.getTotalUserCount(), 5);
+    }
+
+    CachingDatabase::Stats stats = cache->stats();
+    ASSERT_EQ(stats.hits, 18u);
+    ASSERT_EQ(stats.misses, 2u);
+
+    manager.shutdown();
+}
+
+TEST(CachingDatabaseTest, EvictsLeastRecentlyUsed) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 2, std::chrono::milliseconds::zero(), 1);
+
+    ON_CALL(*mock, getUserById(_)).WillByDefault([](int id) {
+        return IDatabase::User{ id, "User " + std::to_string(id), "" };
+    });
+    EXPECT_CALL(*mock, getUserById(1)).Times(2); // Вытеснен, загружается повторно
+    EXPECT_CALL(*mock, getUserById(2)).Times(1);
+    EXPECT_CALL(*mock, getUserById(3)).Times(1);
+
+    cache.getUserById(1);
+    cache.getUserById(2);
+    cache.getUserById(2); // 2 - последний использованный, 1 - кандидат на вытеснение
+    cache.getUserById(3);
+    cache.getUserById(2);
+    cache.getUserById(1);
+
+    ASSERT_EQ(cache.size(), 2u);
+    ASSERT_EQ(cache.stats().evictions, 2u);
+}
+
+TEST(CachingDatabaseTest, ExpiresEntriesAfterTtl) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase::TimePoint now{};
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 100, std::chrono::milliseconds(1000), 4,
+        [&now]() { return now; });
+
+    EXPECT_CALL(*mock, getUserById(1))
+        .Times(2)
+        .WillRepeatedly(Return(IDatabase::User{ 1, "Alice", "alice@example.com" }));
+    EXPECT_CALL(*mock, countUsers())
+        .Times(2)
+        .WillRepeatedly(Return(3));
+
+    cache.getUserById(1);
+    cache.countUsers();
+    now += std::chrono::milliseconds(999);
+    cache.getUserById(1);
+    cache.countUsers();
+    now += std::chrono::milliseconds(1);
+    cache.getUserById(1);
+    cache.countUsers();
+}
+
+TEST(CachingDatabaseTest, InvalidationForcesReload) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 100);
+
+    EXPECT_CALL(*mock, getUserById(1))
+        .WillOnce(Return(IDatabase::User{ 1, "Alice", "alice@example.com" }))
+        .WillOnce(Return(IDatabase::User{ 1, "Alice Smith", "alice@example.com" }));
+    EXPECT_CALL(*mock, countUsers())
+        .WillOnce(Return(3))
+        .WillOnce(Return(4));
+
+    ASSERT_EQ(cache.getUserById(1).name, "Alice");
+    ASSERT_EQ(cache.countUsers(), 3);
+    cache.invalidate(1);
+    cache.invalidateCount();
+    ASSERT_EQ(cache.getUserById(1).name, "Alice Smith");
+    ASSERT_EQ(cache.countUsers(), 4);
+}
+
+TEST(CachingDatabaseTest, InvalidationDuringLoad_DropsStaleValue) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 100);
+
+    // Первая загрузка стоит в БД, пока запись не инвалидируют
+    std::promise<void> loading;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    EXPECT_CALL(*mock, getUserById(1))
+        .WillOnce([&loading, released](int id) {
+            loading.set_value();
+            released.wait();
+            return IDatabase::User{ id, "Alice", "alice@example.com" };
+        })
+        .WillOnce(Return(IDatabase::User{ 1, "Alice Smith", "alice@example.com" }));
+
+    std::thread reader([&cache]() { cache.getUserById(1); });
+    loading.get_future().wait();
+    cache.invalidate(1);
+    release.set_value();
+    reader.join();
+
+    ASSERT_EQ(cache.size(), 0u); // Загруженное до инвалидации значение не закэшировано
+    ASSERT_EQ(cache.getUserById(1).name, "Alice Smith");
+    ASSERT_EQ(cache.getUserById(1).name, "Alice Smith"); // Новое значение уже из кэша
+}
+
+TEST(CachingDatabaseTest, InvalidateCountDuringLoad_DropsStaleCount) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 100);
+
+    std::promise<void> loading;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    EXPECT_CALL(*mock, countUsers())
+        .WillOnce([&loading, released]() {
+            loading.set_value();
+            released.wait();
+            return 3;
+        })
+        .WillOnce(Return(4));
+
+    std::thread reader([&cache]() { cache.countUsers(); });
+    loading.get_future().wait();
+    cache.invalidateCount();
+    release.set_value();
+    reader.join();
+
+    ASSERT_EQ(cache.countUsers(), 4); // Старое значение не закэшировано
+    ASSERT_EQ(cache.countUsers(), 4);
+}
+
+TEST(CachingDatabaseTest, CapacityIsTotalAcrossShards) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    ON_CALL(*mock, getUserById(_)).WillByDefault([](int id) {
+        return IDatabase::User{ id, "User " + std::to_string(id), "" };
+    });
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 10, std::chrono::milliseconds::zero(), 4);
+    for (int id = 0; id < 200; ++id) cache.getUserById(id);
+    ASSERT_EQ(cache.size(), 10u);
+
+    // Шардов больше, чем записей: лишние шарды не создаются
+    NiceMock<MockDatabase>* small_mock = new NiceMock<MockDatabase>();
+    ON_CALL(*small_mock, getUserById(_)).WillByDefault([](int id) {
+        return IDatabase::User{ id, "User " + std::to_string(id), "" };
+    });
+    CachingDatabase small(std::unique_ptr<IDatabase>(small_mock), 3, std::chrono::milliseconds::zero(), 16);
+    for (int id = 0; id < 200; ++id) small.getUserById(id);
+    ASSERT_EQ(small.size(), 3u);
+}
+
+TEST(CachingDatabaseTest, GetUsersByIds_FetchesOnlyMisses) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 100);
+
+    EXPECT_CALL(*mock, getUserById(1))
+        .WillOnce(Return(IDatabase::User{ 1, "Alice", "alice@example.com" }));
+    EXPECT_CALL(*mock, getUsersByIds(_))
+        .WillOnce([](std::span<const int> ids) {
+            EXPECT_THAT(std::vector<int>(ids.begin(), ids.end()), ElementsAre(2, 99));
+            return std::vector<std::optional<IDatabase::User>>{ IDatabase::User{ 2, "Bob", "bob@example.com" }, std::nullopt };
+        });
+
+    cache.getUserById(1);
+    const int ids[] = { 1, 2, 99 };
+    std::vector<std::optional<IDatabase::User>> users = cache.getUsersByIds(ids);
+    ASSERT_EQ(users[0]->name, "Alice");
+    ASSERT_EQ(users[1]->name, "Bob");
+    ASSERT_FALSE(users[2].has_value());
+
+    // Теперь 1 и 2 в кэше, к БД не обращаемся
+    const int cached_ids[] = { 2, 1 };
+    users = cache.getUsersByIds(cached_ids);
+    ASSERT_EQ(users[0]->name, "Bob");
+}
+
+TEST(CachingDatabaseTest, SharedBetweenThreads) {
+    NiceMock<MockDatabase>* mock = new NiceMock<MockDatabase>();
+    CachingDatabase cache(std::unique_ptr<IDatabase>(mock), 64, std::chrono::milliseconds::zero(), 8);
+
+    std::atomic<int> db_calls{ 0 };
+    ON_CALL(*mock, getUserById(_)).WillByDefault([&db_calls](int id) {
+        ++db_calls;
+        return IDatabase::User{ id, "User " + std::to_string(id), "" };
+    });
+
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong{ 0 };
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&cache, &wrong, t]() {
+            for (int i = 0; i < 2000; ++i) {
+                int id = (i * 7 + t) % 100; // Рабочий набор больше емкости - есть и вытеснения
+                if (cache.getUserById(id).name != "User " + std::to_string(id)) ++wrong;
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    CachingDatabase::Stats stats = cache.stats();
+    ASSERT_EQ(wrong.load(), 0);
+    ASSERT_EQ(stats.hits + stats.misses, 16000u);
+    ASSERT_EQ(stats.misses, static_cast<uint64_t>(db_calls.load()));
+    ASSERT_LE(cache.size(), 64u);
+}
+
+// --- Тесты AsyncUserManager ---
+TEST(AsyncUserManagerTest, GetUserName_ReturnsNameOrThrows) {
+    IoExecutor executor(2);
+    AsyncUserManager manager(std::make_unique<AsyncLatencyDatabase>(executor, std::chrono::microseconds(100)));
+
+    ASSERT_THROW(syncWait(manager.getUserName(1)), std::runtime_error); // Еще не подключено
+    ASSERT_TRUE(syncWait(manager.initialize("dummy_connection_string")));
+    ASSERT_EQ(syncWait(manager.getUserName(2)), "Bob Johnson");
+    ASSERT_EQ(syncWait(manager.getTotalUserCount()), 3);
+    ASSERT_THROW(syncWait(manager.getUserName(99)), UserNotFoundError);
+    syncWait(manager.shutdown());
+}
+
+TEST(AsyncUserManagerTest, WhenAll_PropagatesFirstError) {
+    IoExecutor executor(2);
+    AsyncUserManager manager(std::make_unique<AsyncLatencyDatabase>(executor, std::chrono::microseconds(100)));
+    ASSERT_TRUE(syncWait(manager.initialize("dummy_connection_string")));
+
+    std::vector<Task<std::string>> lookups;
+    lookups.push_back(manager.getUserName(1));
+    lookups.push_back(manager.getUserName(42));
+    ASSERT_THROW(syncWait(whenAll(std::move(lookups))), UserNotFoundError);
+    syncWait(manager.shutdown());
+}
+
+// Замер: 10 000 одновременных запросов из одного потока при задержке БД 5 мс.
+// Синхронный UserManager на одном потоке потратил бы 10 000 * 5 мс = 50 с.
+TEST(AsyncUserManagerBenchmark, TenThousandConcurrentLookups) {
+    const std::chrono::microseconds latency(5000);
+    const int lookups_count = 10000;
+    IoExecutor executor(2);
+    auto db = std::make_unique<AsyncLatencyDatabase>(executor, latency);
+    AsyncLatencyDatabase* fake = db.get();
+    AsyncUserManager manager(std::move(db));
+    ASSERT_TRUE(syncWait(manager.initialize("dummy_connection_string")));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Task<std::string>> lookups;
+    lookups.reserve(lookups_count);
+    for (int i = 0; i < lookups_count; ++i) {
+        lookups.push_back(manager.getUserName(1 + i % 3));
+    }
+    std::vector<std::string> names = syncWait(whenAll(std::move(lookups)));
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    std::cout << lookups_count << " concurrent lookups: " << elapsed.count() << " us, "
+        << static_cast<long long>(lookups_count * 1e6 / std::max<long long>(elapsed.count(), 1)) << " lookups/s "
+        << "(sequential estimate " << lookups_count * latency.count() / 1000 << " ms)" << std::endl;
+
+    ASSERT_EQ(names.size(), static_cast<size_t>(lookups_count));
+    ASSERT_EQ(names[0], "Alice Smith");
+    ASSERT_EQ(fake->roundTrips(), lookups_count + 1);
+
+    syncWait(manager.shutdown());
+}
+
+// --- Регрессионные тесты производительности ---
+// Замеряют время операции (лучшее из нескольких повторов) и сравнивают с базовой линией:
+// тест падает, если операция стала медленнее базовой линии больше чем в tolerance раз.
+// Чтобы базовая линия не зависела от машины, она хранится не в наносекундах, а в долях
+// эталонного цикла (поиск в std::map на 1024 записи и копирование строки с выделением
+// памяти), который замеряется в том же запуске. Эталон целиком помещается в кэш, чтобы
+// его время не зависело от раскладки кучи. Встроенные значения - kBuiltinBaseline ниже.
+// Настройка через переменные окружения:
+//   USER_MANAGER_PERF_BASELINE  - файл базовой линии (по умолчанию perf_baseline.txt),
+//                                 строки вида "<имя> <доля эталонного цикла>";
+//                                 записи файла важнее встроенных
+//   USER_MANAGER_PERF_UPDATE=1  - записать текущие результаты как новую базовую линию
+//   USER_MANAGER_PERF_TOLERANCE - допустимое замедление (по умолчанию 3.0)
+//   USER_MANAGER_PERF_LATENCY_US - задержка фейковой БД в микросекундах (по умолчанию 0)
+// Для замеров с задержкой без записи в базовой линии ожидаемым временем служит сама задержка.
+// Замер без базовой линии не проходит молча, а пропускается с явным сообщением.
+class PerfRegression : public ::testing::Environment {
+public:
+    static std::string envOr(const char* name, const std::string& fallback) {
+        const char* value = std::getenv(name);
+        return value && *value ? value : fallback;
+    }
+
+    static std::chrono::microseconds latency() {
+        return std::chrono::microseconds(std::stoll(envOr("USER_MANAGER_PERF_LATENCY_US", "0")));
+    }
+
+    // Лучшее из repetitions время операции в нс; каждый повтор крутит op не меньше budget
+    template <typename Op>
+    static double measureNsPerOp(Op&& op, int repetitions = 3,
+        std::chrono::milliseconds budget = std::chrono::milliseconds(100)) {
+        double best = std::numeric_limits<double>::max();
+        for (int r = 0; r < repetitions; ++r) {
+            size_t ops = 0;
+            auto start = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::steady_clock::duration::zero();
+            do {
+                for (int i = 0; i < 64; ++i, ++ops) op(ops);
+                elapsed = std::chrono::steady_clock::now() - start;
+            } while (elapsed < budget);
+            best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count() / ops);
+        }
+        return best;
+    }
+
+    // Время эталонного цикла в нс; замеряется один раз за запуск
+    static double referenceNs() {
+        PerfRegression& self = instance();
+        if (self.reference > 0) return self.reference;
+
+        std::map<int, std::string> names;
+        for (int id = 0; id < 1024; ++id) names.emplace(id, "reference user #" + std::to_string(id));
+        size_t checksum = 0;
+        self.reference = measureNsPerOp([&](size_t i) {
+            std::string name = names.find(static_cast<int>((i * 7919) % 1024))->second;
+            checksum += name.size();
+        });
+        volatile size_t sink = checksum; // не даёт компилятору выбросить цикл
+        (void)sink;
+        std::cout << "[ PERF     ] reference: " << self.reference << " ns/op" << std::endl;
+        return self.reference;
+    }
+
+    // Сравнение с базовой линией. Порядок поиска: файл, kBuiltinBaseline,
+    // fallbackNs > 0 (ожидаемое время в нс); без базовой линии замер пропускается
+    static void check(const std::string& name, double nsPerOp, double fallbackNs = 0) {
+        PerfRegression& self = instance();
+        const double reference = referenceNs();
+        const double ratio = nsPerOp / reference;
+        self.measured[name] = ratio;
+
+        double expected = 0;
+        if (auto it = self.baseline.find(name); it != self.baseline.end()) {
+            expected = it->second * reference;
+        } else if (auto builtin = builtinRatio(name); builtin > 0) {
+            expected = builtin * reference;
+        } else {
+            expected = fallbackNs;
+        }
+
+        std::cout << "[ PERF     ] " << name << ": " << nsPerOp << " ns/op, x" << ratio << " reference";
+        if (expected > 0) {
+            std::cout << " (baseline " << expected << " ns/op, x" << nsPerOp / expected << ")";
+        }
+        std::cout << std::endl;
+
+        if (self.update) return;
+        if (expected <= 0) {
+            GTEST_SKIP() << "нет базовой линии для " << name
+                << ": запустите с USER_MANAGER_PERF_UPDATE=1 или добавьте запись в kBuiltinBaseline";
+        }
+        EXPECT_LE(nsPerOp, expected * self.tolerance)
+            << name << " стал медленнее базовой линии больше чем в " << self.tolerance << " раз";
+    }
+
+    void SetUp() override {
+        path = envOr("USER_MANAGER_PERF_BASELINE", "perf_baseline.txt");
+        update = envOr("USER_MANAGER_PERF_UPDATE", "0") == "1";
+        tolerance = std::stod(envOr("USER_MANAGER_PERF_TOLERANCE", "3.0"));
+
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            double ratio = 0;
+            if (fields >> name >> ratio && ratio > 0) baseline[name] = ratio;
+        }
+    }
+
+    void TearDown() override {
+        if (!update || measured.empty()) return;
+        // Записи, которые в этом запуске не замерялись, сохраняются
+        for (const auto& [name, ratio] : measured) baseline[name] = ratio;
+        std::ofstream out(path);
+        for (const auto& [name, ratio] : baseline) out << name << " " << ratio << "\n";
+        std::cout << "Базовая линия записана в " << path << std::endl;
+    }
+
+    static PerfRegression& instance() {
+        static PerfRegression* environment = static_cast<PerfRegression*>(
+            ::testing::AddGlobalTestEnvironment(new PerfRegression()));
+        return *environment;
+    }
+
+private:
+    // Встроенная базовая линия: время операции в долях эталонного цикла,
+    // замерено с запасом относительно типичного результата
+    struct BuiltinBaseline {
+        const char* name;
+        double ratio;
+    };
+    static constexpr BuiltinBaseline kBuiltinBaseline[] = {
+        { "MyDatabase.getUserById", 18 },
+        { "UserManager.getUserName@0us", 11 },
+        { "UserManager.getTotalUserCount@0us", 0.35 },
+    };
+
+    static double builtinRatio(const std::string& name) {
+        for (const auto& entry : kBuiltinBaseline) {
+            if (name == entry.name) return entry.ratio;
+        }
+        return 0;
+    }
+
+    std::string path;
+    bool update = false;
+    double tolerance = 3.0;
+    double reference = 0;
+    std::map<std::string, double> baseline;
+    std::map<std::string, double> measured;
+};
+
+// Окружение регистрируется до RUN_ALL_TESTS, чтобы SetUp прочитал базовую линию
+static PerfRegression& perf_regression_environment = PerfRegression::instance();
+
+// Имя замера включает задержку, чтобы базовые линии разных конфигураций не смешивались
+static std::string perfName(const std::string& operation) {
+    return operation + "@" + std::to_string(PerfRegression::latency().count()) + "us";
+}
+
+TEST(PerfRegressionTest, MyDatabase_GetUserById) {
+    MyDatabase db;
+    for (int id = 4; id <= 100000; ++id) {
+        db.addUser({ id, "User " + std::to_string(id), "u" + std::to_string(id) + "@ex.com" });
+    }
+    ASSERT_TRUE(db.connect("dummy_connection_string"));
+
+    size_t checksum = 0;
+    double ns = PerfRegression::measureNsPerOp([&](size_t i) {
+        checksum += db.getUserById(1 + static_cast<int>((i * 7919) % 100000)).name.size();
+    });
+    ASSERT_GT(checksum, 0u);
+    PerfRegression::check("MyDatabase.getUserById", ns);
+}
+
+TEST(PerfRegressionTest, UserManager_GetUserName) {
+    UserManager manager(std::make_unique<LatencyDatabase>(PerfRegression::latency()));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    size_t checksum = 0;
+    double ns = PerfRegression::measureNsPerOp([&](size_t i) {
+        checksum += manager.getUserName(1 + static_cast<int>(i % 3)).size();
+    });
+    ASSERT_GT(checksum, 0u);
+    // Один запрос - одно обращение к БД: время не должно заметно превышать задержку
+    PerfRegression::check(perfName("UserManager.getUserName"), ns,
+        std::chrono::duration<double, std::nano>(PerfRegression::latency()).count());
+    manager.shutdown();
+}
+
+TEST(PerfRegressionTest, UserManager_GetTotalUserCount) {
+    UserManager manager(std::make_unique<LatencyDatabase>(PerfRegression::latency()));
+    ASSERT_TRUE(manager.initialize("dummy_connection_string"));
+
+    int total = 0;
+    double ns = PerfRegression::measureNsPerOp([&](size_t) {
+        total += manager.getTotalUserCount();
+    });
+    ASSERT_GT(total, 0);
+    PerfRegression::check(perfName("UserManager.getTotalUserCount"), ns,
+        std::chrono::duration<double, std::nano>(PerfRegression::latency()).count());
+    manager.shutdown();
+}
+
 // --- Основная функция для запуска тестов ---
 int main(int argc, char** argv) {
     ::testing::InitGoogleMock(&argc, argv);
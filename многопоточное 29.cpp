@@ -5,12 +5,20 @@
 #include <stdexcept> // Для исключений
 #include <algorithm> // Для std::min
 #include <cstdlib>   // Для rand()
+#include <atomic>    // Для размера, версий и снимков без блокировок
+#include <cstdint>
+
+// Версия узла, который еще не удален
+constexpr uint64_t kLiveVersion = UINT64_MAX;
 
 // --- Структура узла ---
 struct Node {
     int value;
-    Node* next;
+    std::atomic<Node*> next; // Атомарный: снимки обходят список без блокировок
     std::mutex* node_mutex; // Мьютекс для данного узла
+    uint64_t inserted_version = 0; // Версия очереди, в которой узел появился
+    std::atomic<uint64_t> removed_version{ kLiveVersion }; // Версия, в которой узел удален
+    uint64_t unlinked_version = 0; // Версия, после которой узел исключен из списка физически
 
     // Конструктор узла
     Node(int val, Node* nxt = nullptr) : value(val), next(nxt) {
@@ -24,10 +32,74 @@ struct Node {
 };
 
 // --- Класс очереди с мелкогранулярной блокировкой ---
+// Все изменения идут под queue_mutex и увеличивают версию очереди. Читатели
+// (мониторинг, printList) берут снимок: запоминают версию и видят ровно те узлы,
+// что были в очереди в этой версии, - без блокировок, не задерживая писателей.
+// Удаление (pop_front) только помечает узел; исключение из списка и освобождение
+// откладываются, пока узел может понадобиться активным снимкам (эпохи по версиям).
 class FineGrainedQueue {
 private:
     Node* head;
     std::mutex* queue_mutex; // Мьютекс для доступа к head, size и т.д.
+    std::atomic<int> size{ 0 }; // Число неудаленных элементов
+    std::atomic<uint64_t> version{ 0 }; // Растет при каждом изменении (под queue_mutex)
+
+    // Версии активных снимков; 0 - слот свободен
+    static constexpr int kMaxSnapshots = 64;
+    struct alignas(64) SnapshotSlot {
+        std::atomic<uint64_t> version{ 0 };
+    };
+    mutable SnapshotSlot snapshot_slots[kMaxSnapshots]; // Снимок занимает слот у const-очереди
+
+    std::vector<Node*> retired; // Исключенные из списка узлы, ждущие освобождения (под queue_mutex)
+
+    static bool isLive(const Node* node) {
+        return node->removed_version.load(std::memory_order_relaxed) == kLiveVersion;
+    }
+
+    // Под queue_mutex: узел становится видимым снимкам с версией >= новой
+    void linkAfter(Node* prev_node, Node* new_node) {
+        new_node->inserted_version = version.load(std::memory_order_relaxed) + 1;
+        new_node->next.store(prev_node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        prev_node->next.store(new_node, std::memory_order_release);
+        version.fetch_add(1, std::memory_order_release);
+        size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Под queue_mutex. Удаленный узел исключается из списка, когда ни одному активному
+    // снимку он не нужен (все снимки не старше версии удаления), и освобождается, когда
+    // на нем не может стоять ни один читатель (все снимки взяты после исключения).
+    // Удаленные узлы всегда образуют начало списка в порядке удаления (pop_front берет
+    // первый живой узел, insertIntoMiddle вставляет после них), поэтому обход
+    // останавливается на первом узле, который еще нужен снимкам или не удален
+    void reclaim() {
+        // Сначала сдвигаем версию: снимок, слот которого мы не увидим, заметит это и перечитает версию
+        version.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = version.load(std::memory_order_relaxed);
+        for (const SnapshotSlot& slot : snapshot_slots) {
+            uint64_t snapshot_version = slot.version.load(std::memory_order_acquire);
+            if (snapshot_version != 0) oldest = std::min(oldest, snapshot_version);
+        }
+
+        auto freed = std::partition(retired.begin(), retired.end(),
+            [&](const Node* node) { return node->unlinked_version > oldest; });
+        for (auto it = freed; it != retired.end(); ++it) delete *it;
+        retired.erase(freed, retired.end());
+
+        const size_t already_retired = retired.size();
+        for (Node* current = head->next.load(std::memory_order_relaxed);
+            current != nullptr && current->removed_version.load(std::memory_order_relaxed) <= oldest;
+            current = head->next.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> head_lock(*head->node_mutex);
+            head->next.store(current->next.load(std::memory_order_relaxed), std::memory_order_release);
+            retired.push_back(current); // current->next не меняется: стоящий на нем читатель пройдет дальше
+        }
+        if (retired.size() > already_retired) {
+            uint64_t unlink_version = version.fetch_add(1, std::memory_order_seq_cst) + 1;
+            for (size_t i = already_retired; i < retired.size(); ++i) retired[i]->unlinked_version = unlink_version;
+        }
+    }
 
 public:
     // Конструктор
@@ -50,6 +122,7 @@ public:
             current = current->next;
             delete temp; // Удаляем узел (и его мьютекс)
         }
+        for (Node* node : retired) delete node; // Снимков уже нет
         delete queue_mutex; // Удаляем мьютекс очереди
     }
 
@@ -84,8 +157,7 @@ public:
             // Важно: если head->next == nullptr, то prev_node это head.
             // Блокируем мьютекс head
             std::lock_guard<std::mutex> head_lock(*head->node_mutex);
-            new_node->next = head->next; // head->next пока nullptr
-            head->next = new_node;
+            linkAfter(head, new_node); // head->next пока nullptr
             // new_node->next уже nullptr (по конструктору)
         }
         else {
@@ -97,18 +169,99 @@ public:
             // tail теперь последний узел.
             // Нам нужно заблокировать его мьютекс, чтобы безопасно изменить next.
             std::lock_guard<std::mutex> tail_lock(*tail->node_mutex);
-            new_node->next = tail->next; // tail->next = nullptr
-            tail->next = new_node;
+            linkAfter(tail, new_node); // tail->next = nullptr
         }
     }
 
-    // Метод для отображения списка (для отладки)
-    void printList() {
+    // Извлечение первого элемента; false, если очередь пуста
+    bool pop_front(int& value) {
+        std::lock_guard<std::mutex> q_lock(*queue_mutex);
+        Node* current = head->next;
+        while (current != nullptr && !isLive(current)) current = current->next;
+        if (current == nullptr) return false;
+
+        value = current->value;
+        // Снимки с версией меньше новой еще видят узел
+        current->removed_version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        version.fetch_add(1, std::memory_order_release);
+        size.fetch_sub(1, std::memory_order_relaxed);
+        reclaim();
+        return true;
+    }
+
+    // --- Снимок очереди ---
+    // Согласованное состояние очереди на момент взятия снимка. Обход не берет блокировок
+    // и не мешает писателям; пока снимок жив, узлы, которые он видит, не освобождаются.
+    // Снимок используется в одном потоке; одновременно - не больше kMaxSnapshots снимков.
+    class Snapshot {
+    public:
+        class iterator {
+        public:
+            iterator(Node* start, uint64_t snapshot_version) : node(start), version(snapshot_version) { skipInvisible(); }
+            int operator*() const { return node->value; }
+            iterator& operator++() {
+                node = node->next.load(std::memory_order_acquire);
+                skipInvisible();
+                return *this;
+            }
+            bool operator!=(const iterator& other) const { return node != other.node; }
+
+        private:
+            Node* node;
+            uint64_t version;
+
+            // Пропускаем узлы, добавленные после снимка или удаленные до него
+            void skipInvisible() {
+                while (node != nullptr && (node->inserted_version > version ||
+                    node->removed_version.load(std::memory_order_acquire) <= version)) {
+                    node = node->next.load(std::memory_order_acquire);
+                }
+            }
+        };
+
+        explicit Snapshot(const FineGrainedQueue& owner) : queue(owner) {
+            for (;;) { // Свободный слот; если все заняты - ждем, писателей это не задерживает
+                for (SnapshotSlot& candidate : queue.snapshot_slots) {
+                    uint64_t free_slot = 0;
+                    version = queue.version.load(std::memory_order_acquire);
+                    if (candidate.version.compare_exchange_strong(free_slot, version, std::memory_order_seq_cst)) {
+                        slot = &candidate;
+                        break;
+                    }
+                }
+                if (slot) break;
+                std::this_thread::yield();
+            }
+            // Если reclaim не увидел слот, он уже сдвинул версию - берем снимок заново
+            for (;;) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                uint64_t current = queue.version.load(std::memory_order_acquire);
+                if (current == version) break;
+                version = current;
+                slot->version.store(version, std::memory_order_seq_cst);
+            }
+        }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        ~Snapshot() { slot->version.store(0, std::memory_order_release); }
+
+        iterator begin() const { return iterator(queue.head->next.load(std::memory_order_acquire), version); }
+        iterator end() const { return iterator(nullptr, version); }
+        uint64_t snapshotVersion() const { return version; }
+
+    private:
+        const FineGrainedQueue& queue;
+        SnapshotSlot* slot = nullptr;
+        uint64_t version = 0;
+    };
+
+    Snapshot snapshot() const { return Snapshot(*this); }
+
+    // Метод для отображения списка (для отладки); печатает снимок, не блокируя писателей
+    void printList() const {
         std::cout << "List: HEAD -> ";
-        Node* current = head->next; // Начинаем с первого реального узла
-        while (current != nullptr) {
-            std::cout << current->value << " -> ";
-            current = current->next;
+        for (int value : snapshot()) {
+            std::cout << value << " -> ";
         }
         std::cout << "nullptr" << std::endl;
     }
@@ -208,8 +361,10 @@ public:
 
             // Перемещаем prev_node к следующему узлу
             prev_node = prev_node->next; // Переходим к следующему узлу
-            current_pos++;
+            if (isLive(prev_node)) current_pos++; // Удаленные узлы позиций не занимают
         }
+        // Удаленные узлы остаются в начале списка: новый узел встает после них
+        while (prev_node->next != nullptr && !isLive(prev_node->next)) prev_node = prev_node->next;
 
         // Теперь `prev_node` указывает на узел, после которого мы должны вставить.
         // Если `pos` был больше длины, `prev_node` теперь последний узел.
@@ -226,37 +381,24 @@ public:
         // Но нам нужно держать блокировки на prev_node и new_node.
         // Порядок: prev_node->node_mutex, затем new_node->node_mutex.
 
-        // Получаем указатель на следующий узел *до* блокировки prev_node
-        Node* old_next = prev_node->next;
-
         // Блокируем мьютекс предыдущего узла
         std::lock_guard<std::mutex> prev_lock(*(prev_node->node_mutex));
 
         // Блокируем мьютекс нового узла
         std::lock_guard<std::mutex> new_lock(*(new_node->node_mutex));
 
-        // Теперь, когда оба узла заблокированы, безопасно выполняем модификации
-
-        // 1. Связываем новый узел с его следующим элементом
-        new_node->next = old_next; // old_next может быть nullptr, если вставляем в конец
-
-        // 2. Связываем предыдущий узел с новым узлом
-        prev_node->next = new_node;
+        // Теперь, когда оба узла заблокированы, безопасно выполняем модификации:
+        // new_node->next = prev_node->next (может быть nullptr, если вставляем в конец),
+        // затем prev_node->next = new_node - так снимки никогда не видят оборванный список
+        linkAfter(prev_node, new_node);
 
         // Блокировки prev_lock и new_lock автоматически снимутся при выходе из функции.
     }
 
     // --- Дополнительные вспомогательные методы (для тестирования) ---
-    // Метод для получения длины списка (не потокобезопасный сам по себе,
-    // но может быть использован в контексте, где блокировки уже взяты)
-    int getSize() {
-        int count = 0;
-        Node* current = head->next;
-        while (current != nullptr) {
-            count++;
-            current = current->next;
-        }
-        return count;
+    // Длина списка за O(1): счетчик меняется вместе со списком под queue_mutex
+    int getSize() const {
+        return size.load(std::memory_order_relaxed);
     }
 
     // Метод для получения узла по индексу (используется для тестирования,
@@ -288,7 +430,7 @@ public:
                 // Для head, просто переходим к первому реальному узлу
                 current = current->next;
             }
-            current_index++;
+            if (current != nullptr && isLive(current)) current_index++; // Удаленные узлы пропускаем
         }
 
         // Если current == nullptr, значит, индекс был за пределами списка
@@ -398,5 +540,52 @@ int main() {
     std::cout << "Список после вставки 5 на pos=0: ";
     queue.printList(); // HEAD -> 5 -> 10 -> 15 -> 20 -> 25 -> 30 -> 40 -> 50 -> nullptr
 
+    // Мониторинг по снимкам во время работы производителя и потребителя.
+    // Производитель добавляет 1, 2, 3..., потребитель извлекает с головы, поэтому
+    // в любом согласованном снимке - подряд идущие числа
+    std::cout << "\n--- Снимки во время работы производителя и потребителя ---" << std::endl;
+    FineGrainedQueue stream;
+    const int items_count = 20000;
+    std::atomic<bool> done{ false };
+    std::thread producer([&] {
+        for (int value = 1; value <= items_count; ++value) stream.push_back(value);
+    });
+    std::thread consumer([&] {
+        int value = 0;
+        for (int taken = 0; taken < items_count;) {
+            if (stream.pop_front(value)) ++taken;
+            else std::this_thread::yield();
+        }
+        done = true;
+    });
+    int snapshots = 0;
+    int inconsistent = 0;
+    std::vector<std::thread> monitors;
+    std::mutex monitor_mutex;
+    for (int m = 0; m < 2; ++m) {
+        monitors.emplace_back([&] {
+            int local_snapshots = 0;
+            int local_inconsistent = 0;
+            while (!done) {
+                int previous = -1;
+                bool contiguous = true;
+                for (int value : stream.snapshot()) {
+                    if (previous != -1 && value != previous + 1) contiguous = false;
+                    previous = value;
+                }
+                ++local_snapshots;
+                if (!contiguous) ++local_inconsistent;
+            }
+            std::lock_guard<std::mutex> lock(monitor_mutex);
+            snapshots += local_snapshots;
+            inconsistent += local_inconsistent;
+        });
+    }
+    producer.join();
+    consumer.join();
+    for (std::thread& monitor : monitors) monitor.join();
+    std::cout << "Снимков: " << snapshots << ", несогласованных: " << inconsistent // Ожидаем 0
+        << ", размер в конце: " << stream.getSize() << std::endl; // Ожидаем 0
+
     return 0;
 }
\ No newline at end of file
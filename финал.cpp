@@ -25,43 +25,329 @@
 #include <QHeaderView>
 #include <QComboBox>
 #include <QDateTime>
+#include <QThread>
+#include <QThreadStorage>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QAbstractTableModel>
+#include <QSqlField>
+#include <QSqlDriver>
+#include <QTimer>
+#include <QSet>
+#include <QCheckBox>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QFontDatabase>
+#include <QProgressDialog>
+#include <QFileDialog>
+#include <QFile>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <zlib.h>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <array>
+#include <string_view>
 
 // --- Предварительные объявления (Forward Declarations) ---
 class DatabaseManager;
+class BanExpiryScheduler;
 class BanUserDialog;
+class LiveTableModel;
+class ExportWorker;
+class RetentionJob;
+class UserStatsJob;
+class AdminDataService;
+class AdminBenchmark;
+
+// --- 1. UserStatusCache ---
+// Статус пользователя в памяти (вместо сравнения строк "banned"/"disconnected")
+enum class UserStatus : quint8 {
+    Unknown = 0,
+    Active,
+    Banned,
+    Disconnected
+};
+
+UserStatus userStatusFromString(const QString& status);
+
+// Кэш статусов: плотный массив по user_id. Статус и срок бана (в секундах)
+// упакованы в одно 64-битное атомарное слово, поэтому чтение не берет блокировок
+// и стоит одного обращения к памяти. Страницы выделяются по мере роста id
+// и освобождаются только в деструкторе, так что читатели не видят висячих указателей.
+class UserStatusCache {
+public:
+    UserStatusCache();
+    ~UserStatusCache();
+
+    void set(int userId, UserStatus status, qint64 banEndSecs = 0);
+    UserStatus status(int userId) const;
+    qint64 banEndSecs(int userId) const;
+    bool isBanned(int userId, qint64 nowSecs) const; // Бан с истекшим сроком не считается
+    void clear();
+
+private:
+    static const int kPageBits = 16;
+    static const int kPageSize = 1 << kPageBits;
+    static const int kPageCount = 1 << (31 - kPageBits); // Покрывает все неотрицательные int
+
+    quint64 load(int userId) const;
+
+    std::atomic<std::atomic<quint64>*>* pages;
+};
+
+// --- 2. QueryStats ---
+// Инструментирование запросов: по каждому оператору (или метке) - число
+// выполнений, строк, суммарное и максимальное время и гистограмма времени
+// по степеням двойки в микросекундах. Запись - несколько атомарных
+// инкрементов, поэтому сбор статистики можно не выключать.
+class QueryStats {
+public:
+    static const int kBuckets = 24; // 1 мкс .. ~8 с, последняя корзина - все, что дольше
+    static const int kSlowLogSize = 100;
+
+    struct Statement {
+        std::atomic<quint64> count{ 0 };
+        std::atomic<quint64> errors{ 0 };
+        std::atomic<quint64> rows{ 0 };
+        std::atomic<quint64> rows_unknown{ 0 }; // Выполнения, для которых драйвер не знает число строк
+        std::atomic<quint64> total_us{ 0 };
+        std::atomic<quint64> max_us{ 0 };
+        std::atomic<quint64> buckets[kBuckets] = {};
+    };
+
+    ~QueryStats();
+
+    void record(const QString& key, qint64 elapsedUs, qint64 rows, bool ok); // rows < 0 - неизвестно
+    void recordSlow(const QString& entry); // Кольцевой журнал медленных запросов
+    QString report() const;                // Текстовая таблица, самые затратные операторы сверху
+    void reset();
+
+private:
+    Statement* statement(const QString& key);
+    static quint64 percentileUs(const Statement& stats, double fraction);
+
+    mutable QReadWriteLock lock; // Защищает только словарь; счетчики атомарные
+    QHash<QString, Statement*> statements;
+
+    mutable QMutex slow_lock;
+    QStringList slow_log;
+};
+
+// --- 3. DatabaseManager ---
+// Параметры подключения. Кроме PostgreSQL поддерживается SQLite (файл или база
+// в памяти) - для нагрузочных тестов на машине без сервера.
+struct DatabaseConfig {
+    enum class Backend {
+        Postgres,
+        SqliteFile,
+        SqliteMemory
+    };
+
+    Backend backend = Backend::Postgres;
+    QString host = "localhost";
+    int port = 5432;
+    QString database = "messanger_db";
+    QString user = "your_db_user";          // ЗАМЕНИТЬ!
+    QString password = "your_db_password";  // ЗАМЕНИТЬ!
+    QString sqlite_path = "messanger.sqlite";
+
+    // Тестовые данные, которые нужно сгенерировать после подключения
+    int generate_users = 0;
+    int generate_messages = 0;
+
+    // --sqlite <файл> | --memory | --pg-host, --pg-port, --pg-db, --pg-user, --pg-password;
+    // --generate-users <N>, --generate-messages <N>
+    static DatabaseConfig fromArguments(const QStringList& arguments);
+};
 
-// --- 1. DatabaseManager ---
 // Объявление класса DatabaseManager, чтобы ServerMainWindow мог его использовать
 class DatabaseManager : public QObject {
     Q_OBJECT
 
 public:
-    explicit DatabaseManager(QObject* parent = nullptr);
+    explicit DatabaseManager(const DatabaseConfig& config = DatabaseConfig(), QObject* parent = nullptr);
     ~DatabaseManager();
 
+    using BulkProgress = std::function<bool(int done, int total)>; // false - отменить операцию
+
     bool connectToDatabase();
     void disconnectFromDatabase();
     bool isConnected() const;
 
     void createTablesIfNeeded(); // Создает таблицы, если их нет
+    bool isPostgres() const;     // false - SQLite: нет ILIKE, уведомлений и серверных курсоров
+    QString currentDateSql() const; // Сегодняшняя дата по местному времени (время сообщений в SQLite - местное)
+
+    // Генератор нагрузочных данных: userCount пользователей и messageCount сообщений
+    // между ними (или между уже существующими пользователями). Строки порождаются
+    // на стороне СУБД пачками по kGenerateChunkSize, каждая пачка - своя транзакция.
+    bool generateTestData(int userCount, int messageCount, const BulkProgress& progress = BulkProgress());
 
     // Пользователи
     QSqlTableModel* getUsersModel();
     bool setUserStatus(int userId, const QString& status);
     bool banUser(int userId, const QString& reason, const QDateTime& endDate);
     bool unbanUser(int userId); // Просто устанавливает статус на 'active'
+    int liftExpiredBans(const QList<int>& userIds); // Снимает истекшие баны пачкой, возвращает число снятых, -1 при ошибке
+
+    // Потоковый обход результата SELECT серверным курсором пачками по batchSize строк:
+    // в памяти одновременно не больше одной пачки. Можно вызывать из рабочего потока
+    // (соединение берется из пула). onRow возвращает false для отмены.
+    bool streamQuery(const QString& select, int batchSize, const std::function<bool(const QSqlQuery& row)>& onRow);
+    qint64 estimateRowCount(const QString& table); // Оценка без count(*): статистика планировщика или max(rowid)
+
+    // Переносит до batchSize сообщений старше cutoff в messages_archive одной короткой
+    // транзакцией. Возвращает число перенесенных строк или -1 при ошибке.
+    int archiveMessagesBatch(const QDateTime& cutoff, int batchSize);
+    int archiveMessagesBatchSqlite(const QDateTime& cutoff, int batchSize); // Без DELETE ... RETURNING в CTE
+
+    // Дельта-агрегация статистики пользователей: учитывает в user_stats сообщения
+    // после сохраненной отметки (не больше maxMessages сообщений за вызов, включая уже
+    // перенесенные в messages_archive) и сдвигает отметку.
+    // Возвращает число учтенных сообщений или -1 при ошибке.
+    int refreshUserStats(int maxMessages);
+
+    // Выполнение с замером времени. Статистика группируется по label,
+    // а если он пуст - по тексту запроса. Медленные запросы пишутся в журнал
+    // вместе с параметрами.
+    bool execPrepared(QSqlQuery& query, const QString& label = QString());
+    bool execSql(QSqlQuery& query, const QString& sql, const QString& label = QString());
+    QString queryStatsReport() const;
+    void resetQueryStats();
+
+    // Статус из кэша в памяти, без обращения к БД. Потокобезопасно.
+    UserStatus userStatus(int userId) const;
+    bool isUserBanned(int userId) const;
+
+    // Массовые операции: один UPDATE ... WHERE user_id = ANY(:ids) на пачку id, все пачки
+    // в одной транзакции. Возвращают число измененных строк или -1 при ошибке/отмене.
+    int setUsersStatus(const QList<int>& userIds, const QString& status, const BulkProgress& progress = BulkProgress());
+    int banUsers(const QList<int>& userIds, const QString& reason, const QDateTime& endDate, const BulkProgress& progress = BulkProgress());
 
     // Сообщения
     QSqlTableModel* getMessagesModel();
     bool addMessage(int senderId, int receiverId, const QString& text, const QString& type);
     bool deleteMessage(int messageId); // Опционально
 
+    // Уведомления об изменениях (PostgreSQL LISTEN/NOTIFY).
+    // Возвращает false, если драйвер их не поддерживает - тогда нужен опрос.
+    bool subscribeToChanges();
+
+signals:
+    void usersChanged(const QList<int>& userIds); // Изменения других процессов, пачкой за kNotifyCoalesceMs
+    void messageInserted(int messageId);
+    void bansExpired(const QList<int>& userIds);
+
+private slots:
+    void on_notification(const QString& name, QSqlDriver::NotificationSource source, const QVariant& payload);
+    void on_users_notify_timeout();
+
 private:
+    // --- Пул соединений ---
+    // Соединение потока вместе с кэшем подготовленных запросов.
+    // Соединения QtSql нельзя передавать между потоками, поэтому каждый поток
+    // получает собственное именованное соединение (клон основного).
+    struct PooledConnection {
+        QString name;
+        QSqlDatabase handle;
+        QHash<QString, QSqlQuery*> statements; // SQL -> подготовленный запрос
+        QElapsedTimer last_used;
+        // Слот пула (null для основного соединения). Семафор общий с DatabaseManager:
+        // рабочий поток может завершиться уже после удаления менеджера
+        QSharedPointer<QSemaphore> slot;
+
+        ~PooledConnection();
+    };
+
+    PooledConnection* currentConnection();
+    bool checkConnectionHealth(PooledConnection* conn);
+    QSqlQuery* preparedQuery(const QString& sql); // Подготовленный запрос из кэша текущего потока
+
+    static const int kMaxPooledConnections = 8;   // Максимум соединений рабочих потоков
+    static const int kPoolAcquireTimeoutMs = 5000;
+    static const int kHealthCheckIdleMs = 30000;  // Проверять соединение после такого простоя
+    static const int kBulkChunkSize = 10000;      // id в одном UPDATE массовой операции
+    static const int kSlowQueryThresholdMs = 100; // Порог для журнала медленных запросов
+    static const int kGenerateChunkSize = 100000; // Строк тестовых данных в одном INSERT ... SELECT
+    static const int kNotifyCoalesceMs = 50;      // Окно склейки уведомлений users_changed
+
+    void recordQuery(const QSqlQuery& query, const QString& label, qint64 elapsedUs, bool ok);
+
+    void loadUserStatuses(); // Кэш статусов и расписание снятия банов
+    void refreshUserStatuses(const QList<int>& userIds); // Один запрос на пачку (по kBulkChunkSize id)
+    // UPDATE ... WHERE <idsCondition> пачками в одной транзакции; в changedIds (если задан) -
+    // id действительно измененных строк (RETURNING user_id), возвращает их число или -1
+    int updateUsersInChunks(const QString& sql, const QList<int>& userIds, const QVariantMap& binds,
+        const BulkProgress& progress, QList<int>* changedIds = nullptr);
+    // Диалект SQL: у PostgreSQL и SQLite расходятся массивы, функции времени и блокировки
+    QString dialect(const QString& postgresSql, const QString& sqliteSql) const;
+    QString idsCondition() const;                  // user_id входит в :ids
+    QString idArrayLiteral(const QList<int>& ids) const; // {1,2,3} для PostgreSQL, [1,2,3] для json_each в SQLite
+    QVariant timestampValue(const QDateTime& value) const; // В SQLite - строка того же формата, что и DEFAULT столбцов
+    void configureConnection(QSqlDatabase& handle);
+
     QSqlDatabase db;
+    bool postgres = true;
     bool connected = false;
+    BanExpiryScheduler* ban_scheduler;
+    QTimer users_notify_timer;
+    QSet<int> notified_user_ids; // Ждут refreshUserStatuses
+    UserStatusCache status_cache;
+    QueryStats query_stats;
+
+    PooledConnection main_connection; // Соединение потока, в котором живет DatabaseManager (GUI)
+    QSharedPointer<QSemaphore> pool_slots{ new QSemaphore(kMaxPooledConnections) };
+    QThreadStorage<PooledConnection*> thread_connections;
+};
+
+// --- 4. BanExpiryScheduler ---
+// Планировщик снятия истекших банов: min-куча сроков и один таймер на
+// ближайший срок. При срабатывании все баны, истекшие к этому моменту,
+// снимаются одним проходом (пачкой UPDATE), сколько бы их ни было.
+// Если UPDATE не удался, эти баны планируются повторно через kRetryIntervalMs.
+class BanExpiryScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    explicit BanExpiryScheduler(DatabaseManager* manager);
+
+    void schedule(int userId, const QDateTime& endDate);
+    void cancel(int userId);
+    void clear();
+
+private slots:
+    void on_timeout();
+
+private:
+    struct Entry {
+        qint64 deadline_ms;
+        int user_id;
+        bool operator>(const Entry& other) const { return deadline_ms > other.deadline_ms; }
+    };
+
+    void rearm();
+    void compact();
+
+    static constexpr qint64 kMaxTimerIntervalMs = 3600 * 1000; // QTimer не умеет интервалы длиннее ~24 дней
+    static constexpr qint64 kRetryIntervalMs = 60 * 1000;      // После ошибки снятия банов
+
+    DatabaseManager* db_manager;
+    QTimer timer;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    QHash<int, qint64> deadlines; // Актуальный срок пользователя; записи кучи с другим сроком устарели
 };
 
-// --- 2. BanUserDialog ---
+// --- 5. BanUserDialog ---
 // Объявление класса BanUserDialog
 class BanUserDialog : public QDialog {
     Q_OBJECT
@@ -70,9 +356,10 @@ public:
     explicit BanUserDialog(QWidget* parent = nullptr);
 
     void setUserId(int userId, const QString& username);
+    void setUserIds(const QList<int>& userIds, const QString& description); // Массовый бан
 
 signals:
-    void userBanned(int userId, const QString& reason, const QDateTime& endDate);
+    void usersBanned(const QList<int>& userIds, const QString& reason, const QDateTime& endDate);
 
 private slots:
     void on_ban_button_clicked();
@@ -80,8 +367,7 @@ private slots:
     void update_ban_date_label();
 
 private:
-    int current_user_id;
-    QString current_username;
+    QList<int> current_user_ids;
 
     QLabel* user_info_label;
     QLabel* reason_label;
@@ -92,13 +378,231 @@ private:
     QPushButton* cancel_button;
 };
 
-// --- 3. ServerMainWindow ---
+// --- 6. LiveTableModel ---
+// Табличная модель с инкрементальным обновлением. Строки идентифицируются
+// ключевым столбцом: новые строки добавляются через beginInsertRows,
+// измененные обновляются через dataChanged - без сброса модели,
+// поэтому выделение и позиция прокрутки в представлении сохраняются.
+// Строки загружаются страницами по kPageSize в порядке ключа (keyset: "ключ больше
+// последнего загруженного"); следующую страницу представление запрашивает через
+// fetchMore, когда прокрутка доходит до конца.
+class LiveTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    // Выполненный запрос до limit строк с ключом больше afterKey, по возрастанию ключа
+    using PageLoader = std::function<QSqlQuery(qint64 afterKey, int limit)>;
+
+    static const int kPageSize = 1000;
+
+    LiveTableModel(const QStringList& fields, const QString& keyField, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool setHeaderData(int section, Qt::Orientation orientation, const QVariant& value, int role = Qt::EditRole) override;
+    bool canFetchMore(const QModelIndex& parent = QModelIndex()) const override;
+    void fetchMore(const QModelIndex& parent = QModelIndex()) override;
+
+    int fieldIndex(const QString& field) const;
+    QSqlRecord record(int row) const;
+    qint64 maxKey() const { return max_key; } // Наибольший загруженный ключ (для выборки "новее чем")
+    bool fullyLoaded() const { return !has_more; } // Загружены все страницы
+
+    void reset(const PageLoader& loader); // Перезагрузка с первой страницы (например, при смене фильтра)
+    // Вставка новых и обновление существующих строк. Новые ключи дальше загруженных
+    // страниц пропускаются: они придут со следующими страницами
+    void upsert(QSqlQuery& query);
+
+private:
+    QStringList field_names;
+    int key_column;
+    QVector<QVariant> headers;
+    QVector<QVector<QVariant>> rows;
+    QHash<qint64, int> row_by_key;
+    qint64 max_key = 0;
+    PageLoader page_loader;
+    bool has_more = false;
+
+    QVector<QVariant> readRow(const QSqlQuery& query, const QVector<int>& mapping) const;
+    QVector<int> columnMapping(const QSqlQuery& query) const;
+};
+
+// --- 7. ExportWorker ---
+// Выгрузка таблицы в CSV (или CSV.gz, если имя файла оканчивается на .gz)
+// в фоновом потоке. Строки читаются серверным курсором и пишутся сразу,
+// поэтому расход памяти не зависит от размера таблицы.
+class ExportWorker : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Table { Users, Messages };
+
+    ExportWorker(DatabaseManager* manager, Table table, const QString& path);
+
+    void cancel(); // Потокобезопасно
+
+public slots:
+    void run();
+
+signals:
+    void progress(qint64 rows, qint64 estimatedTotal);
+    void finished(bool ok, qint64 rows, const QString& error);
+
+private:
+    bool openOutput();
+    bool writeOutput(const QByteArray& data);
+    bool closeOutput();
+    static void appendCsvField(QByteArray& out, const QVariant& value);
+
+    static const int kFetchBatchSize = 10000;
+    static const int kFlushBytes = 1 << 20; // Сбрасываем буфер на диск примерно по мегабайту
+
+    DatabaseManager* db_manager;
+    Table table;
+    QString path;
+    std::atomic<bool> canceled{ false };
+
+    QFile file;
+    gzFile gz = nullptr;
+};
+
+// --- 8. RetentionJob ---
+// Хранение сообщений: все, что старше retentionDays, переносится в
+// messages_archive пачками с паузами между ними. Каждая пачка - отдельная
+// короткая транзакция, поэтому задание можно прервать в любой момент,
+// а после перезапуска оно продолжит с оставшихся строк.
+class RetentionJob : public QObject {
+    Q_OBJECT
+
+public:
+    RetentionJob(DatabaseManager* manager, int retentionDays);
+
+public slots:
+    void start(); // Вызывается в потоке задания
+    void stop();
+
+signals:
+    void batchArchived(int rows);
+
+private slots:
+    void run_batch();
+
+private:
+    static const int kBatchSize = 5000;
+    static const int kBatchPauseMs = 200;             // Пауза между пачками, чтобы не мешать основной нагрузке
+    static const int kRetryIntervalMs = 60 * 1000;    // После ошибки
+    static const int kIdleIntervalMs = 3600 * 1000;   // Когда переносить нечего
+
+    DatabaseManager* db_manager;
+    int retention_days;
+    QTimer* timer = nullptr;
+};
+
+// --- 9. UserStatsJob ---
+// Периодическая дельта-агрегация user_stats. При первом запуске история
+// догоняется кусками по kChunkMessages сообщений, дальше хватает одного короткого
+// запроса раз в kIntervalMs.
+class UserStatsJob : public QObject {
+    Q_OBJECT
+
+public:
+    explicit UserStatsJob(DatabaseManager* manager);
+
+public slots:
+    void start(); // Вызывается в потоке задания
+
+signals:
+    void statsUpdated();
+
+private slots:
+    void run_refresh();
+
+private:
+    static const int kChunkMessages = 100000;
+    static const int kCatchUpPauseMs = 50;
+    static const int kIntervalMs = 10000;
+
+    DatabaseManager* db_manager;
+    QTimer* timer = nullptr;
+};
+
+// --- 10. AdminDataService ---
+// Пути данных панели без виджетов: построение и выполнение запросов
+// пользователей и сообщений. Используется окном и бенчмарком.
+// Запросы идут через основное соединение - вызывать из потока DatabaseManager.
+class AdminDataService {
+public:
+    struct MessageFilter {
+        enum class Type {
+            All,
+            Public,
+            Private
+        };
+
+        QString text;                 // Подстрока без учета регистра
+        Type type = Type::All;
+        bool include_archive = false; // Искать также в messages_archive
+    };
+
+    explicit AdminDataService(DatabaseManager* manager);
+
+    // Столбцы результатов (и моделей, которые их отображают)
+    static QStringList userFields();
+    static QStringList messageFields();
+
+    // Возвращают выполненный forward-only запрос; при ошибке он неактивен (isActive() == false).
+    // Страница - до limit строк с ключом больше after* по возрастанию ключа; limit == 0 - без предела
+    QSqlQuery selectUsers(qint64 afterUserId = 0, int limit = 0);
+    QSqlQuery selectNewUsers(qint64 afterUserId);
+    QSqlQuery selectUserRows(const QList<int>& userIds);
+    QSqlQuery selectMessages(const MessageFilter& filter, qint64 afterMessageId = 0, int limit = 0);
+
+private:
+    QString usersSelect(const QString& condition = QString()) const;
+
+    DatabaseManager* db_manager;
+};
+
+// --- 11. AdminBenchmark ---
+// Безголовый замер путей данных панели на наборах разного размера
+// (--benchmark [--benchmark-sizes 10000,1000000,10000000] [--benchmark-repeats N]).
+// Данные генерируются по нарастающей, результаты - JSON Lines в stdout.
+class AdminBenchmark {
+public:
+    AdminBenchmark(const DatabaseConfig& config, const QStringList& arguments);
+
+    int run(); // Код возврата процесса
+
+private:
+    struct FilterCase {
+        QString name;
+        AdminDataService::MessageFilter filter;
+    };
+
+    void report(qint64 datasetRows, const QString& metric, double value, const QString& unit);
+    void measureLoad(qint64 datasetRows, const QString& name, const QStringList& fields, const QString& keyField,
+        const LiveTableModel::PageLoader& loader);
+    void measureFilter(qint64 datasetRows, const FilterCase& filterCase);
+    static qint64 residentMemoryKb(); // VmRSS из /proc/self/status, -1 если недоступно
+
+    DatabaseConfig config;
+    QString backend_name;
+    QList<qint64> dataset_sizes{ 10000, 1000000, 10000000 };
+    int repeats = 5;
+    DatabaseManager* db_manager = nullptr;
+    AdminDataService* data_service = nullptr;
+    QTextStream out;
+};
+
+// --- 12. ServerMainWindow ---
 // Объявление главного окна, которое использует DatabaseManager и BanUserDialog
 class ServerMainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    ServerMainWindow(QWidget* parent = nullptr);
+    explicit ServerMainWindow(DatabaseManager* manager, QWidget* parent = nullptr); // Забирает владение подключенным manager
     ~ServerMainWindow();
 
 private slots:
@@ -115,9 +619,23 @@ private slots:
     // Слоты для таблиц
     void on_user_table_double_clicked(const QModelIndex& index);
     void on_user_selection_changed();
+    void apply_message_filters();
+
+    // Живое обновление таблиц
+    void on_users_changed(const QList<int>& userIds);
+    void on_message_inserted(int messageId);
+    void apply_live_updates();
+    void poll_live_updates();
+
+    void load_user_rows(const QList<int>& userIds);
+
+    // Экспорт
+    void on_export_users_button_clicked();
+    void on_export_messages_button_clicked();
+    void refresh_query_stats();
 
     // Слоты из диалога бана
-    void process_ban_user_dialog(int userId, const QString& reason, const QDateTime& endDate);
+    void process_ban_user_dialog(const QList<int>& userIds, const QString& reason, const QDateTime& endDate);
 
 private:
     void setup_ui();
@@ -127,8 +645,20 @@ private:
     void load_messages();
     void refresh_user_list();
     void refresh_message_list();
+    AdminDataService::MessageFilter current_message_filter() const; // Фильтр из полей вкладки
+    void load_new_messages();
+    void load_new_users();
+
+    // Цели действий над пользователями: выделенные строки или все найденные фильтром
+    QList<int> target_user_rows() const;
+    QList<int> target_user_ids(UserStatus status, QString* description) const;
+    int run_bulk_operation(const QString& label, int total, const std::function<int(const DatabaseManager::BulkProgress&)>& operation);
+    void start_export(ExportWorker::Table table, const QString& title);
+
+    static const int kBulkProgressThreshold = 10000; // С какого размера показывать прогресс
 
     DatabaseManager* db_manager; // Менеджер базы данных
+    AdminDataService data_service;
 
     QTabWidget* tab_widget;
 
@@ -136,35 +666,324 @@ private:
     QWidget* users_tab;
     QTableView* users_table;
     QSortFilterProxyModel* users_proxy_model;
-    QSqlTableModel* users_sql_model;
+    LiveTableModel* users_model;
     QLineEdit* users_search_filter;
     QPushButton* refresh_users_button;
     QPushButton* ban_user_button;
     QPushButton* unban_user_button;
     QPushButton* disconnect_user_button;
+    QCheckBox* apply_to_matching_check; // Применять действия ко всем найденным фильтром
+    QPushButton* export_users_button;
 
     // --- Вкладка Сообщения ---
     QWidget* messages_tab;
     QTableView* messages_table;
     QSortFilterProxyModel* messages_proxy_model;
-    QSqlTableModel* messages_sql_model;
+    LiveTableModel* messages_model;
     QLineEdit* messages_search_filter;
     QComboBox* messages_filter_combo;
+    QCheckBox* messages_include_archive_check; // Искать также в messages_archive
     QPushButton* refresh_messages_button;
     QPushButton* delete_message_button; // Опционально
+    QPushButton* export_messages_button;
+
+    // --- Вкладка Запросы ---
+    QWidget* query_stats_tab;
+    QTextEdit* query_stats_view;
+    QPushButton* refresh_query_stats_button;
+    QPushButton* reset_query_stats_button;
 
     // --- Диалоги ---
     BanUserDialog* ban_dialog;
+
+    // --- Живое обновление ---
+    QTimer* live_poll_timer;  // Опрос новых строк, если СУБД не умеет уведомлять
+    QTimer* live_apply_timer; // Склеивает пачку уведомлений в один запрос
+    QSet<int> pending_user_ids;
+    bool pending_messages = false;
+
+    // --- Хранение сообщений ---
+    static const int kMessageRetentionDays = 90;
+    QThread* maintenance_thread; // Хранение сообщений и статистика пользователей
+};
+
+// --- Реализация UserStatusCache ---
+// Статусы известны при сборке, и младшие два бита первого символа ('a', 'b', 'd')
+// у них различны - это совершенный хеш. Таблица строится компилятором (коллизия -
+// ошибка компиляции), а разбор - одна проба и одно сравнение вместо цепочки сравнений.
+struct UserStatusName {
+    std::string_view text;
+    UserStatus status = UserStatus::Unknown;
+};
+
+constexpr UserStatusName kUserStatusNames[] = {
+    { "active", UserStatus::Active },
+    { "banned", UserStatus::Banned },
+    { "disconnected", UserStatus::Disconnected },
 };
 
+constexpr int kUserStatusSlots = 4;
+
+constexpr int userStatusSlot(char16_t first) {
+    return first & (kUserStatusSlots - 1);
+}
+
+constexpr std::array<UserStatusName, kUserStatusSlots> makeUserStatusTable() {
+    std::array<UserStatusName, kUserStatusSlots> table{};
+    for (const UserStatusName& name : kUserStatusNames) {
+        UserStatusName& slot = table[userStatusSlot(name.text[0])];
+        if (!slot.text.empty()) throw "userStatusSlot: коллизия статусов";
+        slot = name;
+    }
+    return table;
+}
+
+constexpr std::array<UserStatusName, kUserStatusSlots> kUserStatusTable = makeUserStatusTable();
+
+UserStatus userStatusFromString(const QString& status) {
+    if (status.isEmpty()) return UserStatus::Unknown;
+    const UserStatusName& name = kUserStatusTable[userStatusSlot(status.at(0).unicode())];
+    return status == QLatin1String(name.text.data(), static_cast<int>(name.text.size())) ? name.status : UserStatus::Unknown;
+}
+
+UserStatusCache::UserStatusCache() : pages(new std::atomic<std::atomic<quint64>*>[kPageCount]()) {
+}
+
+UserStatusCache::~UserStatusCache() {
+    for (int i = 0; i < kPageCount; ++i) {
+        delete[] pages[i].load(std::memory_order_relaxed);
+    }
+    delete[] pages;
+}
+
+void UserStatusCache::set(int userId, UserStatus status, qint64 banEndSecs) {
+    if (userId < 0) return;
+    std::atomic<std::atomic<quint64>*>& slot = pages[userId >> kPageBits];
+    std::atomic<quint64>* page = slot.load(std::memory_order_acquire);
+    if (!page) {
+        std::atomic<quint64>* fresh = new std::atomic<quint64>[kPageSize]();
+        if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) {
+            page = fresh;
+        }
+        else {
+            delete[] fresh; // Страницу уже выделил другой поток
+        }
+    }
+    quint64 packed = (static_cast<quint64>(qMax<qint64>(banEndSecs, 0)) << 8) | static_cast<quint8>(status);
+    page[userId & (kPageSize - 1)].store(packed, std::memory_order_release);
+}
+
+quint64 UserStatusCache::load(int userId) const {
+    if (userId < 0) return 0;
+    std::atomic<quint64>* page = pages[userId >> kPageBits].load(std::memory_order_acquire);
+    return page ? page[userId & (kPageSize - 1)].load(std::memory_order_acquire) : 0;
+}
+
+UserStatus UserStatusCache::status(int userId) const {
+    return static_cast<UserStatus>(load(userId) & 0xFF);
+}
+
+qint64 UserStatusCache::banEndSecs(int userId) const {
+    return static_cast<qint64>(load(userId) >> 8);
+}
+
+bool UserStatusCache::isBanned(int userId, qint64 nowSecs) const {
+    quint64 packed = load(userId);
+    if (static_cast<UserStatus>(packed & 0xFF) != UserStatus::Banned) return false;
+    qint64 ban_end = static_cast<qint64>(packed >> 8);
+    return ban_end == 0 || ban_end > nowSecs; // 0 - бессрочный бан
+}
+
+void UserStatusCache::clear() {
+    // Страницы не освобождаются: их могут читать другие потоки
+    for (int i = 0; i < kPageCount; ++i) {
+        std::atomic<quint64>* page = pages[i].load(std::memory_order_acquire);
+        if (!page) continue;
+        for (int j = 0; j < kPageSize; ++j) page[j].store(0, std::memory_order_relaxed);
+    }
+}
+
+// --- Реализация QueryStats ---
+QueryStats::~QueryStats() {
+    qDeleteAll(statements);
+}
+
+QueryStats::Statement* QueryStats::statement(const QString& key) {
+    {
+        QReadLocker locker(&lock);
+        Statement* stats = statements.value(key);
+        if (stats) return stats;
+    }
+    QWriteLocker locker(&lock);
+    Statement*& stats = statements[key];
+    if (!stats) stats = new Statement; // Не удаляется до деструктора: указатель можно держать без блокировки
+    return stats;
+}
+
+void QueryStats::record(const QString& key, qint64 elapsedUs, qint64 rows, bool ok) {
+    Statement* stats = statement(key);
+    quint64 us = static_cast<quint64>(qMax<qint64>(elapsedUs, 0));
+
+    stats->count.fetch_add(1, std::memory_order_relaxed);
+    if (!ok) stats->errors.fetch_add(1, std::memory_order_relaxed);
+    if (rows > 0) stats->rows.fetch_add(static_cast<quint64>(rows), std::memory_order_relaxed);
+    if (rows < 0) stats->rows_unknown.fetch_add(1, std::memory_order_relaxed);
+    stats->total_us.fetch_add(us, std::memory_order_relaxed);
+
+    quint64 max_us = stats->max_us.load(std::memory_order_relaxed);
+    while (us > max_us && !stats->max_us.compare_exchange_weak(max_us, us, std::memory_order_relaxed)) {
+    }
+
+    // Корзина i хранит времена в диапазоне [2^(i-1), 2^i) мкс
+    int bucket = 0;
+    while (bucket < kBuckets - 1 && (quint64(1) << bucket) <= us) ++bucket;
+    stats->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void QueryStats::recordSlow(const QString& entry) {
+    QMutexLocker locker(&slow_lock);
+    slow_log.append(entry);
+    if (slow_log.size() > kSlowLogSize) slow_log.removeFirst();
+}
+
+quint64 QueryStats::percentileUs(const Statement& stats, double fraction) {
+    quint64 count = stats.count.load(std::memory_order_relaxed);
+    quint64 target = static_cast<quint64>(count * fraction);
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += stats.buckets[i].load(std::memory_order_relaxed);
+        if (seen > target) return quint64(1) << i; // Верхняя граница корзины
+    }
+    return stats.max_us.load(std::memory_order_relaxed);
+}
+
+QString QueryStats::report() const {
+    struct Row {
+        QString key;
+        const Statement* stats;
+    };
+    QList<Row> rows;
+    {
+        QReadLocker locker(&lock);
+        for (auto it = statements.constBegin(); it != statements.constEnd(); ++it) {
+            rows.append({ it.key(), it.value() });
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.stats->total_us.load(std::memory_order_relaxed) > b.stats->total_us.load(std::memory_order_relaxed);
+    });
+
+    QString text;
+    QTextStream out(&text);
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9  %10\n")
+        .arg("count", 9).arg("errors", 7).arg("rows", 11).arg("total ms", 11).arg("avg us", 9)
+        .arg("p50 us", 9).arg("p95 us", 9).arg("p99 us", 9).arg("max us", 9).arg("statement");
+    for (const Row& row : rows) {
+        quint64 count = row.stats->count.load(std::memory_order_relaxed);
+        quint64 total_us = row.stats->total_us.load(std::memory_order_relaxed);
+        // SQLite и forward-only выборки не сообщают число строк: "?" - неизвестно,
+        // "N+" - известно только для части выполнений
+        quint64 rows_unknown = row.stats->rows_unknown.load(std::memory_order_relaxed);
+        QString rows_text = QString::number(row.stats->rows.load(std::memory_order_relaxed));
+        if (rows_unknown >= count) rows_text = "?";
+        else if (rows_unknown > 0) rows_text += "+";
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9  %10\n")
+            .arg(count, 9)
+            .arg(row.stats->errors.load(std::memory_order_relaxed), 7)
+            .arg(rows_text, 11)
+            .arg(total_us / 1000, 11)
+            .arg(count ? total_us / count : 0, 9)
+            .arg(percentileUs(*row.stats, 0.50), 9)
+            .arg(percentileUs(*row.stats, 0.95), 9)
+            .arg(percentileUs(*row.stats, 0.99), 9)
+            .arg(row.stats->max_us.load(std::memory_order_relaxed), 9)
+            .arg(row.key.simplified());
+    }
+
+    QMutexLocker locker(&slow_lock);
+    out << "\nМедленные запросы (последние " << slow_log.size() << "):\n";
+    for (const QString& entry : slow_log) {
+        out << entry << "\n";
+    }
+    return text;
+}
+
+void QueryStats::reset() {
+    {
+        QWriteLocker locker(&lock);
+        // Указатели на Statement могли быть сохранены другими потоками - обнуляем, а не удаляем
+        for (Statement* stats : qAsConst(statements)) {
+            stats->count = 0;
+            stats->errors = 0;
+            stats->rows = 0;
+            stats->rows_unknown = 0;
+            stats->total_us = 0;
+            stats->max_us = 0;
+            for (auto& bucket : stats->buckets) bucket = 0;
+        }
+    }
+    QMutexLocker locker(&slow_lock);
+    slow_log.clear();
+}
+
 // --- Реализация DatabaseManager ---
-DatabaseManager::DatabaseManager(QObject* parent) : QObject(parent) {
-    db = QSqlDatabase::addDatabase("QPSQL");
-    db.setHostName("localhost");
-    db.setPort(5432);
-    db.setDatabaseName("messanger_db");
-    db.setUserName("your_db_user");          // ЗАМЕНИТЬ!
-    db.setPassword("your_db_password");      // ЗАМЕНИТЬ!
+DatabaseConfig DatabaseConfig::fromArguments(const QStringList& arguments) {
+    DatabaseConfig config;
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString& arg = arguments.at(i);
+        QString value = i + 1 < arguments.size() ? arguments.at(i + 1) : QString();
+        if (arg == "--memory") {
+            config.backend = Backend::SqliteMemory;
+            continue;
+        }
+        if (arg == "--sqlite") {
+            config.backend = Backend::SqliteFile;
+            config.sqlite_path = value;
+        }
+        else if (arg == "--pg-host") config.host = value;
+        else if (arg == "--pg-port") config.port = value.toInt();
+        else if (arg == "--pg-db") config.database = value;
+        else if (arg == "--pg-user") config.user = value;
+        else if (arg == "--pg-password") config.password = value;
+        else if (arg == "--generate-users") config.generate_users = value.toInt();
+        else if (arg == "--generate-messages") config.generate_messages = value.toInt();
+        else continue;
+        ++i; // Значение параметра
+    }
+    return config;
+}
+
+DatabaseManager::DatabaseManager(const DatabaseConfig& config, QObject* parent) : QObject(parent), ban_scheduler(new BanExpiryScheduler(this)) {
+    users_notify_timer.setSingleShot(true);
+    users_notify_timer.setInterval(kNotifyCoalesceMs);
+    connect(&users_notify_timer, &QTimer::timeout, this, &DatabaseManager::on_users_notify_timeout);
+
+    switch (config.backend) {
+    case DatabaseConfig::Backend::Postgres:
+        db = QSqlDatabase::addDatabase("QPSQL");
+        db.setHostName(config.host);
+        db.setPort(config.port);
+        db.setDatabaseName(config.database);
+        db.setUserName(config.user);
+        db.setPassword(config.password);
+        break;
+    case DatabaseConfig::Backend::SqliteFile:
+        db = QSqlDatabase::addDatabase("QSQLITE");
+        db.setDatabaseName(config.sqlite_path);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        break;
+    case DatabaseConfig::Backend::SqliteMemory:
+        // Общий кэш: соединения пула (клоны основного) видят ту же базу в памяти,
+        // а не создают каждое свою пустую
+        db = QSqlDatabase::addDatabase("QSQLITE");
+        db.setDatabaseName(QString("file:messanger_mem_%1?mode=memory&cache=shared").arg(reinterpret_cast<quintptr>(this)));
+        db.setConnectOptions("QSQLITE_OPEN_URI;QSQLITE_BUSY_TIMEOUT=5000");
+        break;
+    }
+    postgres = config.backend == DatabaseConfig::Backend::Postgres;
+
+    main_connection.name = db.connectionName();
+    main_connection.handle = db;
 }
 
 DatabaseManager::~DatabaseManager() {
@@ -173,9 +992,11 @@ DatabaseManager::~DatabaseManager() {
 
 bool DatabaseManager::connectToDatabase() {
     if (db.open()) {
+        configureConnection(db);
         connected = true;
         qDebug() << "Database connected successfully.";
         createTablesIfNeeded(); // Создаем таблицы при подключении
+        loadUserStatuses();
         return true;
     }
     else {
@@ -187,8 +1008,12 @@ bool DatabaseManager::connectToDatabase() {
 
 void DatabaseManager::disconnectFromDatabase() {
     if (db.isOpen()) {
+        qDeleteAll(main_connection.statements);
+        main_connection.statements.clear();
         db.close();
         connected = false;
+        ban_scheduler->clear();
+        status_cache.clear();
         qDebug() << "Database disconnected.";
     }
 }
@@ -197,18 +1022,49 @@ bool DatabaseManager::isConnected() const {
     return connected;
 }
 
+bool DatabaseManager::isPostgres() const {
+    return postgres;
+}
+
+// CURRENT_DATE в SQLite - дата по UTC, а время сообщений там хранится местное
+QString DatabaseManager::currentDateSql() const {
+    return dialect("CURRENT_DATE", "date('now', 'localtime')");
+}
+
+QString DatabaseManager::dialect(const QString& postgresSql, const QString& sqliteSql) const {
+    return postgres ? postgresSql : sqliteSql;
+}
+
+void DatabaseManager::configureConnection(QSqlDatabase& handle) {
+    if (postgres) return;
+    // Внешние ключи в SQLite включаются на каждом соединении; WAL позволяет
+    // читать во время записи из потока обслуживания
+    QSqlQuery pragma(handle);
+    for (const char* statement : { "PRAGMA foreign_keys = ON", "PRAGMA journal_mode = WAL", "PRAGMA synchronous = NORMAL" }) {
+        if (!pragma.exec(statement)) {
+            qDebug() << "Error configuring SQLite connection:" << pragma.lastError().text();
+        }
+    }
+}
+
 void DatabaseManager::createTablesIfNeeded() {
     if (!isConnected()) return;
 
     QSqlQuery query;
 
+    // В SQLite время хранится строкой ISO 8601 с миллисекундами (как и привязанные
+    // QDateTime, см. timestampValue), чтобы сравнение строк совпадало со сравнением времени
+    const QString serial_key = dialect("SERIAL PRIMARY KEY", "INTEGER PRIMARY KEY AUTOINCREMENT");
+    const QString timestamp_now = dialect("TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP",
+        "TIMESTAMP DEFAULT (strftime('%Y-%m-%dT%H:%M:%f', 'now', 'localtime'))");
+
     if (!db.tables().contains("users")) {
         if (query.exec(
             "CREATE TABLE users ("
-            "user_id SERIAL PRIMARY KEY,"
+            "user_id " + serial_key + ","
             "username VARCHAR(50) UNIQUE NOT NULL,"
             "password_hash VARCHAR(255) NOT NULL,"
-            "registration_date TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,"
+            "registration_date " + timestamp_now + ","
             "status VARCHAR(20) DEFAULT 'active',"
             "ban_reason TEXT,"
             "ban_end_date TIMESTAMP WITH TIME ZONE"
@@ -224,11 +1080,11 @@ void DatabaseManager::createTablesIfNeeded() {
     if (!db.tables().contains("messages")) {
         if (query.exec(
             "CREATE TABLE messages ("
-            "message_id SERIAL PRIMARY KEY,"
+            "message_id " + serial_key + ","
             "sender_id INTEGER REFERENCES users(user_id) ON DELETE SET NULL,"
             "receiver_id INTEGER REFERENCES users(user_id) ON DELETE SET NULL,"
             "message_text TEXT NOT NULL,"
-            "timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,"
+            "timestamp " + timestamp_now + ","
             "type VARCHAR(10) NOT NULL"
             ")"
         )) {
@@ -238,187 +1094,1632 @@ void DatabaseManager::createTablesIfNeeded() {
             qDebug() << "Error creating table 'messages':" << query.lastError().text();
         }
     }
+
+    // Архив старых сообщений: без внешних ключей и значений по умолчанию,
+    // message_id сохраняется, чтобы архив можно было искать вместе с основной таблицей
+    if (!db.tables().contains("messages_archive")) {
+        if (query.exec(
+            "CREATE TABLE messages_archive ("
+            "message_id INTEGER PRIMARY KEY,"
+            "sender_id INTEGER,"
+            "receiver_id INTEGER,"
+            "message_text TEXT NOT NULL,"
+            "timestamp TIMESTAMP WITH TIME ZONE,"
+            "type VARCHAR(10) NOT NULL"
+            ")"
+        )) {
+            qDebug() << "Table 'messages_archive' created successfully.";
+        }
+        else {
+            qDebug() << "Error creating table 'messages_archive':" << query.lastError().text();
+        }
+    }
+
+    // Индекс нужен, чтобы задание хранения выбирало старые сообщения без полного сканирования
+    if (!query.exec("CREATE INDEX IF NOT EXISTS messages_timestamp_idx ON messages (timestamp)")) {
+        qDebug() << "Error creating index on messages:" << query.lastError().text();
+    }
+
+    // Предрасчитанная статистика активности: одна строка на пользователя,
+    // обновляется дельтами по message_id (см. refreshUserStats)
+    const QStringList stats_statements = {
+        "CREATE TABLE IF NOT EXISTS user_stats ("
+        "user_id INTEGER PRIMARY KEY REFERENCES users(user_id) ON DELETE CASCADE,"
+        "message_count BIGINT NOT NULL DEFAULT 0,"
+        "public_count BIGINT NOT NULL DEFAULT 0,"
+        "private_count BIGINT NOT NULL DEFAULT 0,"
+        "last_active TIMESTAMP WITH TIME ZONE,"
+        "stats_day DATE,"
+        "messages_today INTEGER NOT NULL DEFAULT 0"
+        ")",
+        // Сортировка по messages_today идет в панели, индекс по ней не использовался
+        "DROP INDEX IF EXISTS user_stats_today_idx",
+        "CREATE TABLE IF NOT EXISTS user_stats_watermark ("
+        "id BOOLEAN PRIMARY KEY DEFAULT TRUE CHECK (id),"
+        "last_message_id INTEGER NOT NULL DEFAULT 0"
+        ")",
+        "INSERT INTO user_stats_watermark (id, last_message_id) VALUES (TRUE, 0) ON CONFLICT (id) DO NOTHING"
+    };
+    for (const QString& statement : stats_statements) {
+        if (!query.exec(statement)) {
+            qDebug() << "Error creating user stats tables:" << query.lastError().text();
+        }
+    }
+
+    // Триггеры NOTIFY для живого обновления панели: полезная нагрузка - id строки.
+    // В SQLite уведомлений нет - панель опрашивает новые строки.
+    if (!postgres) return;
+    const QStringList notify_statements = {
+        "CREATE OR REPLACE FUNCTION notify_user_changed() RETURNS trigger AS $$ "
+        "BEGIN PERFORM pg_notify('users_changed', NEW.user_id::text); RETURN NEW; END; "
+        "$$ LANGUAGE plpgsql",
+        "CREATE OR REPLACE FUNCTION notify_message_inserted() RETURNS trigger AS $$ "
+        "BEGIN PERFORM pg_notify('messages_inserted', NEW.message_id::text); RETURN NEW; END; "
+        "$$ LANGUAGE plpgsql",
+        "DROP TRIGGER IF EXISTS users_notify ON users",
+        "CREATE TRIGGER users_notify AFTER INSERT OR UPDATE ON users "
+        "FOR EACH ROW EXECUTE PROCEDURE notify_user_changed()",
+        "DROP TRIGGER IF EXISTS messages_notify ON messages",
+        "CREATE TRIGGER messages_notify AFTER INSERT ON messages "
+        "FOR EACH ROW EXECUTE PROCEDURE notify_message_inserted()"
+    };
+    for (const QString& statement : notify_statements) {
+        if (!query.exec(statement)) {
+            qDebug() << "Error creating notify trigger:" << query.lastError().text();
+        }
+    }
+}
+
+bool DatabaseManager::subscribeToChanges() {
+    if (!isConnected()) return false;
+    QSqlDriver* driver = db.driver();
+    if (!driver->hasFeature(QSqlDriver::EventNotifications)) return false;
+
+    if (!driver->subscribeToNotification("users_changed") ||
+        !driver->subscribeToNotification("messages_inserted")) {
+        qDebug() << "Error subscribing to notifications:" << driver->lastError().text();
+        return false;
+    }
+    connect(driver, QOverload<const QString&, QSqlDriver::NotificationSource, const QVariant&>::of(&QSqlDriver::notification),
+        this, &DatabaseManager::on_notification, Qt::UniqueConnection);
+    return true;
+}
+
+// Триггер users_notify построчный: массовая операция на N строк дает N уведомлений.
+// Свои изменения (SelfSource - тот же серверный процесс, что и основное соединение)
+// кэш и панель уже применили; чужие копятся kNotifyCoalesceMs и перечитываются одним запросом
+void DatabaseManager::on_notification(const QString& name, QSqlDriver::NotificationSource source, const QVariant& payload) {
+    bool ok = false;
+    int id = payload.toInt(&ok);
+    if (!ok) return;
+
+    if (name == "users_changed") {
+        if (source == QSqlDriver::SelfSource) return;
+        notified_user_ids.insert(id);
+        if (!users_notify_timer.isActive()) users_notify_timer.start();
+    }
+    else if (name == "messages_inserted") {
+        emit messageInserted(id);
+    }
+}
+
+// --- Пул соединений ---
+DatabaseManager::PooledConnection::~PooledConnection() {
+    // Запросы должны быть удалены раньше соединения
+    qDeleteAll(statements);
+    statements.clear();
+    if (slot) {
+        handle.close();
+        handle = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+        slot->release(); // Поток завершился - освобождаем место в пуле
+    }
+}
+
+DatabaseManager::PooledConnection* DatabaseManager::currentConnection() {
+    if (QThread::currentThread() == thread()) {
+        return &main_connection;
+    }
+    if (thread_connections.hasLocalData()) {
+        return thread_connections.localData();
+    }
+
+    // Первое обращение из рабочего потока: занимаем слот пула.
+    // QThreadStorage удалит соединение (и вернет слот) при завершении потока.
+    if (!pool_slots->tryAcquire(1, kPoolAcquireTimeoutMs)) {
+        qDebug() << "Connection pool exhausted:" << kMaxPooledConnections << "connections in use.";
+        return nullptr;
+    }
+    PooledConnection* conn = new PooledConnection;
+    conn->name = QString("messanger_pool_%1_%2")
+        .arg(reinterpret_cast<quintptr>(this))
+        .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    conn->handle = QSqlDatabase::cloneDatabase(db.connectionName(), conn->name);
+    conn->slot = pool_slots;
+    thread_connections.setLocalData(conn);
+    return conn;
+}
+
+bool DatabaseManager::checkConnectionHealth(PooledConnection* conn) {
+    bool idle = !conn->last_used.isValid() || conn->last_used.elapsed() > kHealthCheckIdleMs;
+    conn->last_used.start();
+
+    if (conn->handle.isOpen()) {
+        if (!idle) return true;
+        QSqlQuery ping(conn->handle);
+        if (ping.exec("SELECT 1")) return true;
+        qDebug() << "Connection" << conn->name << "failed health check:" << ping.lastError().text();
+    }
+
+    // Подготовленные запросы привязаны к старой сессии сервера
+    qDeleteAll(conn->statements);
+    conn->statements.clear();
+    conn->handle.close();
+    if (!conn->handle.open()) {
+        qDebug() << "Database connection error:" << conn->handle.lastError().text();
+        return false;
+    }
+    configureConnection(conn->handle);
+    return true;
+}
+
+QSqlQuery* DatabaseManager::preparedQuery(const QString& sql) {
+    PooledConnection* conn = currentConnection();
+    if (!conn || !checkConnectionHealth(conn)) return nullptr;
+
+    QSqlQuery* query = conn->statements.value(sql);
+    if (query) return query;
+
+    query = new QSqlQuery(conn->handle);
+    if (!query->prepare(sql)) {
+        qDebug() << "Error preparing statement:" << query->lastError().text();
+        delete query;
+        return nullptr;
+    }
+    conn->statements.insert(sql, query);
+    return query;
+}
+
+// QSqlTableModel* DatabaseManager::getUsersModel() { /* ... (реализация ниже) ... */ return nullptr; }
+// QSqlTableModel* DatabaseManager::getMessagesModel() { /* ... (реализация ниже) ... */ return nullptr; }
+
+bool DatabaseManager::setUserStatus(int userId, const QString& status) {
+    if (!isConnected()) return false;
+    QSqlQuery* query = preparedQuery("UPDATE users SET status = :status WHERE user_id = :user_id");
+    if (!query) return false;
+    query->bindValue(":status", status);
+    query->bindValue(":user_id", userId);
+
+    bool ok = execPrepared(*query);
+    if (ok) {
+        ban_scheduler->cancel(userId); // Новый статус отменяет запланированное снятие бана
+        status_cache.set(userId, userStatusFromString(status));
+        qDebug() << "User" << userId << "status set to" << status;
+    }
+    else {
+        qDebug() << "Error setting user status:" << query->lastError().text();
+    }
+    query->finish();
+    return ok;
+}
+
+bool DatabaseManager::banUser(int userId, const QString& reason, const QDateTime& endDate) {
+    if (!isConnected()) return false;
+    QSqlQuery* query = preparedQuery("UPDATE users SET status = :status, ban_reason = :reason, ban_end_date = :end_date WHERE user_id = :user_id");
+    if (!query) return false;
+    query->bindValue(":status", "banned");
+    query->bindValue(":reason", reason);
+    query->bindValue(":end_date", timestampValue(endDate));
+    query->bindValue(":user_id", userId);
+
+    bool ok = execPrepared(*query);
+    if (ok) {
+        ban_scheduler->schedule(userId, endDate);
+        status_cache.set(userId, UserStatus::Banned, endDate.toSecsSinceEpoch());
+        qDebug() << "User" << userId << "banned until" << endDate;
+    }
+    else {
+        qDebug() << "Error banning user:" << query->lastError().text();
+    }
+    query->finish();
+    return ok;
+}
+
+bool DatabaseManager::unbanUser(int userId) {
+    return setUserStatus(userId, "active");
+}
+
+QString DatabaseManager::idsCondition() const {
+    return dialect("user_id = ANY(CAST(:ids AS INTEGER[]))", "user_id IN (SELECT value FROM json_each(:ids))");
+}
+
+QString DatabaseManager::idArrayLiteral(const QList<int>& ids) const {
+    QStringList parts;
+    parts.reserve(ids.size());
+    for (int id : ids) parts << QString::number(id);
+    return dialect("{", "[") + parts.join(",") + dialect("}", "]");
+}
+
+QVariant DatabaseManager::timestampValue(const QDateTime& value) const {
+    if (postgres || !value.isValid()) return value;
+    return value.toString("yyyy-MM-ddTHH:mm:ss.zzz");
+}
+
+int DatabaseManager::updateUsersInChunks(const QString& sql, const QList<int>& userIds, const QVariantMap& binds,
+    const BulkProgress& progress, QList<int>* changedIds)
+{
+    if (changedIds) changedIds->clear();
+    if (!isConnected() || userIds.isEmpty()) return 0;
+    // RETURNING есть в PostgreSQL и в SQLite с 3.35
+    QSqlQuery* query = preparedQuery(sql + " RETURNING user_id");
+    if (!query) return -1;
+
+    QSqlDatabase& handle = currentConnection()->handle;
+    if (!handle.transaction()) {
+        qDebug() << "Error starting transaction:" << handle.lastError().text();
+        return -1;
+    }
+
+    int affected = 0;
+    for (int from = 0; from < userIds.size(); from += kBulkChunkSize) {
+        query->bindValue(":ids", idArrayLiteral(userIds.mid(from, kBulkChunkSize)));
+        for (auto it = binds.constBegin(); it != binds.constEnd(); ++it) {
+            query->bindValue(it.key(), it.value());
+        }
+        bool ok = execPrepared(*query);
+        if (ok) {
+            while (query->next()) {
+                ++affected;
+                if (changedIds) changedIds->append(query->value(0).toInt());
+            }
+        }
+        else {
+            qDebug() << "Error in bulk update:" << query->lastError().text();
+        }
+        query->finish();
+
+        int done = qMin(from + kBulkChunkSize, static_cast<int>(userIds.size()));
+        if (!ok || (progress && !progress(done, userIds.size()))) {
+            handle.rollback();
+            if (changedIds) changedIds->clear();
+            return -1;
+        }
+    }
+
+    if (!handle.commit()) {
+        qDebug() << "Error committing bulk update:" << handle.lastError().text();
+        handle.rollback();
+        if (changedIds) changedIds->clear();
+        return -1;
+    }
+    return affected;
+}
+
+int DatabaseManager::setUsersStatus(const QList<int>& userIds, const QString& status, const BulkProgress& progress) {
+    // Кэш и планировщик - только по измененным строкам: удаленные и несуществующие id не кэшируются
+    QList<int> changed_ids;
+    int affected = updateUsersInChunks("UPDATE users SET status = :status WHERE " + idsCondition(),
+        userIds, { { ":status", status } }, progress, &changed_ids);
+    if (affected < 0) return -1;
+
+    UserStatus cached = userStatusFromString(status);
+    for (int userId : changed_ids) {
+        ban_scheduler->cancel(userId);
+        status_cache.set(userId, cached);
+    }
+    qDebug() << affected << "users status set to" << status;
+    return affected;
+}
+
+int DatabaseManager::banUsers(const QList<int>& userIds, const QString& reason, const QDateTime& endDate, const BulkProgress& progress) {
+    QList<int> changed_ids;
+    int affected = updateUsersInChunks("UPDATE users SET status = 'banned', ban_reason = :reason, ban_end_date = :end_date "
+        "WHERE " + idsCondition(),
+        userIds, { { ":reason", reason }, { ":end_date", timestampValue(endDate) } }, progress, &changed_ids);
+    if (affected < 0) return -1;
+
+    qint64 end_secs = endDate.toSecsSinceEpoch();
+    for (int userId : changed_ids) {
+        ban_scheduler->schedule(userId, endDate);
+        status_cache.set(userId, UserStatus::Banned, end_secs);
+    }
+    qDebug() << affected << "users banned until" << endDate;
+    return affected;
+}
+
+int DatabaseManager::liftExpiredBans(const QList<int>& userIds) {
+    // Условие на ban_end_date защищает от гонки с повторным баном на больший срок
+    QList<int> lifted_ids;
+    int lifted = updateUsersInChunks("UPDATE users SET status = 'active' "
+        "WHERE " + idsCondition() + " AND status = 'banned' AND ban_end_date <= :now",
+        userIds, { { ":now", timestampValue(QDateTime::currentDateTime()) } }, BulkProgress(), &lifted_ids);
+    if (lifted < 0) return -1;
+
+    // Не снятых забанили снова, продлили бан или удалили в другом процессе:
+    // их статус и срок перечитываются, планировщик получает новый срок
+    QSet<int> lifted_set(lifted_ids.begin(), lifted_ids.end());
+    QList<int> not_lifted;
+    for (int userId : userIds) {
+        if (!lifted_set.contains(userId)) not_lifted << userId;
+    }
+    if (!not_lifted.isEmpty()) refreshUserStatuses(not_lifted);
+    if (lifted == 0) return 0;
+
+    for (int userId : lifted_ids) status_cache.set(userId, UserStatus::Active);
+    qDebug() << "Expired bans lifted:" << lifted;
+    emit bansExpired(lifted_ids);
+    return lifted;
+}
+
+void DatabaseManager::loadUserStatuses() {
+    ban_scheduler->clear();
+    status_cache.clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!execSql(query, "SELECT user_id, status, ban_end_date FROM users")) {
+        qDebug() << "Error loading user statuses:" << query.lastError().text();
+        return;
+    }
+    while (query.next()) {
+        int userId = query.value(0).toInt();
+        UserStatus status = userStatusFromString(query.value(1).toString());
+        QDateTime ban_end = query.value(2).toDateTime();
+
+        status_cache.set(userId, status, ban_end.isValid() ? ban_end.toSecsSinceEpoch() : 0);
+        if (status == UserStatus::Banned && ban_end.isValid()) {
+            ban_scheduler->schedule(userId, ban_end);
+        }
+    }
+}
+
+void DatabaseManager::on_users_notify_timeout() {
+    QList<int> userIds = notified_user_ids.values();
+    notified_user_ids.clear();
+    refreshUserStatuses(userIds);
+    emit usersChanged(userIds);
+}
+
+void DatabaseManager::refreshUserStatuses(const QList<int>& userIds) {
+    QSqlQuery* query = preparedQuery("SELECT user_id, status, ban_end_date FROM users WHERE " + idsCondition());
+    if (!query) return;
+    for (int from = 0; from < userIds.size(); from += kBulkChunkSize) {
+        query->bindValue(":ids", idArrayLiteral(userIds.mid(from, kBulkChunkSize)));
+        if (!execPrepared(*query)) {
+            qDebug() << "Error refreshing user statuses:" << query->lastError().text();
+            break;
+        }
+        while (query->next()) {
+            int userId = query->value(0).toInt();
+            UserStatus status = userStatusFromString(query->value(1).toString());
+            QDateTime ban_end = query->value(2).toDateTime();
+            status_cache.set(userId, status, ban_end.isValid() ? ban_end.toSecsSinceEpoch() : 0);
+            if (status == UserStatus::Banned && ban_end.isValid()) {
+                ban_scheduler->schedule(userId, ban_end);
+            }
+            else {
+                ban_scheduler->cancel(userId);
+            }
+        }
+        query->finish();
+    }
+}
+
+bool DatabaseManager::streamQuery(const QString& select, int batchSize, const std::function<bool(const QSqlQuery& row)>& onRow) {
+    if (!isConnected()) return false;
+    PooledConnection* conn = currentConnection();
+    if (!conn || !checkConnectionHealth(conn)) return false;
+
+    // Курсор живет только внутри транзакции
+    QSqlDatabase& handle = conn->handle;
+    if (!postgres) {
+        // SQLite и так отдает строки по одной по мере выполнения запроса
+        QSqlQuery rows(handle);
+        rows.setForwardOnly(true);
+        if (!execSql(rows, select, "stream_query")) {
+            qDebug() << "Error streaming query:" << rows.lastError().text();
+            return false;
+        }
+        while (rows.next()) {
+            if (!onRow(rows)) return false;
+        }
+        return true;
+    }
+
+    if (!handle.transaction()) {
+        qDebug() << "Error starting transaction:" << handle.lastError().text();
+        return false;
+    }
+
+    QSqlQuery cursor(handle);
+    if (!execSql(cursor, "DECLARE stream_cursor NO SCROLL CURSOR FOR " + select, "DECLARE stream_cursor")) {
+        qDebug() << "Error declaring cursor:" << cursor.lastError().text();
+        handle.rollback();
+        return false;
+    }
+
+    QSqlQuery fetch(handle);
+    fetch.setForwardOnly(true);
+    const QString fetch_sql = QString("FETCH FORWARD %1 FROM stream_cursor").arg(batchSize);
+    bool ok = true;
+    bool more = true;
+    while (ok && more) {
+        if (!execSql(fetch, fetch_sql, "FETCH stream_cursor")) {
+            qDebug() << "Error fetching from cursor:" << fetch.lastError().text();
+            ok = false;
+            break;
+        }
+        int fetched = 0;
+        while (fetch.next()) {
+            ++fetched;
+            if (!onRow(fetch)) {
+                ok = false; // Отменено вызывающим
+                break;
+            }
+        }
+        fetch.finish();
+        more = fetched == batchSize;
+    }
+
+    cursor.exec("CLOSE stream_cursor");
+    if (ok) {
+        handle.commit();
+    }
+    else {
+        handle.rollback();
+    }
+    return ok;
+}
+
+qint64 DatabaseManager::estimateRowCount(const QString& table) {
+    if (!postgres) {
+        // Статистики нет, но rowid растет монотонно: удаленные строки не вычитаются
+        QSqlQuery* query = preparedQuery(QString("SELECT COALESCE(MAX(rowid), 0) FROM %1").arg(table));
+        if (!query) return -1;
+        qint64 estimate = (execPrepared(*query) && query->next()) ? query->value(0).toLongLong() : -1;
+        query->finish();
+        return estimate;
+    }
+
+    QSqlQuery* query = preparedQuery("SELECT reltuples::BIGINT FROM pg_class WHERE relname = :table");
+    if (!query) return -1;
+    query->bindValue(":table", table);
+    qint64 estimate = (execPrepared(*query) && query->next()) ? query->value(0).toLongLong() : -1;
+    query->finish();
+    return estimate;
+}
+
+int DatabaseManager::archiveMessagesBatch(const QDateTime& cutoff, int batchSize) {
+    if (!isConnected()) return -1;
+    if (!postgres) return archiveMessagesBatchSqlite(cutoff, batchSize);
+    // SKIP LOCKED: не ждем строки, которые сейчас держит кто-то другой.
+    // Без ON CONFLICT: id, который уже есть в архиве, откатывает весь запрос с ошибкой
+    // (задание повторит его и напишет в журнал), а не удаляет строку без копии
+    QSqlQuery* query = preparedQuery(
+        "WITH moved AS ("
+        "  DELETE FROM messages WHERE message_id IN ("
+        "    SELECT message_id FROM messages WHERE timestamp < :cutoff"
+        "    ORDER BY timestamp LIMIT :batch_size FOR UPDATE SKIP LOCKED)"
+        "  RETURNING message_id, sender_id, receiver_id, message_text, timestamp, type"
+        ") "
+        "INSERT INTO messages_archive (message_id, sender_id, receiver_id, message_text, timestamp, type) "
+        "SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM moved");
+    if (!query) return -1;
+    query->bindValue(":cutoff", cutoff);
+    query->bindValue(":batch_size", batchSize);
+
+    int moved = -1;
+    if (execPrepared(*query)) {
+        moved = query->numRowsAffected(); // Вставлено в архив == удалено из messages
+    }
+    else {
+        qDebug() << "Error archiving messages:" << query->lastError().text();
+    }
+    query->finish();
+    return moved;
+}
+
+int DatabaseManager::archiveMessagesBatchSqlite(const QDateTime& cutoff, int batchSize) {
+    PooledConnection* conn = currentConnection();
+    if (!conn || !checkConnectionHealth(conn)) return -1;
+    QSqlDatabase& handle = conn->handle;
+
+    // Пишущая транзакция SQLite исключает других писателей, поэтому оба запроса
+    // выбирают одни и те же строки. Конфликт id с архивом - ошибка и откат, как в PostgreSQL
+    const QString batch = "SELECT message_id FROM messages WHERE timestamp < :cutoff "
+        "ORDER BY timestamp, message_id LIMIT :batch_size";
+    QSqlQuery* copy_query = preparedQuery(
+        "INSERT INTO messages_archive (message_id, sender_id, receiver_id, message_text, timestamp, type) "
+        "SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM messages "
+        "WHERE message_id IN (" + batch + ")");
+    QSqlQuery* delete_query = preparedQuery("DELETE FROM messages WHERE message_id IN (" + batch + ")");
+    if (!copy_query || !delete_query) return -1;
+
+    if (!handle.transaction()) {
+        qDebug() << "Error starting transaction:" << handle.lastError().text();
+        return -1;
+    }
+    for (QSqlQuery* query : { copy_query, delete_query }) {
+        query->bindValue(":cutoff", timestampValue(cutoff));
+        query->bindValue(":batch_size", batchSize);
+        if (!execPrepared(*query)) {
+            qDebug() << "Error archiving messages:" << query->lastError().text();
+            query->finish();
+            handle.rollback();
+            return -1;
+        }
+    }
+    int moved = delete_query->numRowsAffected();
+    copy_query->finish();
+    delete_query->finish();
+
+    if (!handle.commit()) {
+        qDebug() << "Error committing archive batch:" << handle.lastError().text();
+        handle.rollback();
+        return -1;
+    }
+    return moved;
+}
+
+int DatabaseManager::refreshUserStats(int maxMessages) {
+    if (!isConnected()) return -1;
+    PooledConnection* conn = currentConnection();
+    if (!conn || !checkConnectionHealth(conn)) return -1;
+    QSqlDatabase& handle = conn->handle;
+
+    // Отметка блокируется на время транзакции: два обновления не посчитают одно сообщение дважды
+    // (в SQLite FOR UPDATE нет: второй писатель и так получит SQLITE_BUSY и откатится)
+    QSqlQuery* lock_query = preparedQuery("SELECT last_message_id FROM user_stats_watermark WHERE id" + dialect(" FOR UPDATE", ""));
+    // Архивированные сообщения тоже учитываются: статистика - за всю историю, а задание
+    // хранения могло перенести их в архив раньше, чем до них дошла отметка.
+    // Перенос атомарен, так что в одном запросе каждое сообщение видно ровно в одной таблице
+    const QString all_messages = "(SELECT message_id, sender_id, timestamp, type FROM messages "
+        "UNION ALL SELECT message_id, sender_id, timestamp, type FROM messages_archive) all_messages";
+    // Кусок - следующие maxMessages существующих сообщений, а не диапазон id: иначе
+    // пропуск длиннее куска (например, после архивации) навсегда остановил бы отметку.
+    // Последние секунды пропускаем: транзакции с меньшими id могут еще не закоммититься
+    QSqlQuery* bound_query = preparedQuery("SELECT COALESCE(MAX(message_id), :from_id), COUNT(*) FROM "
+        "(SELECT message_id FROM " + all_messages + " WHERE message_id > :from_id "
+        "AND timestamp < " + dialect("CURRENT_TIMESTAMP - INTERVAL '5 seconds'",
+            "strftime('%Y-%m-%dT%H:%M:%f', 'now', 'localtime', '-5 seconds')") + " "
+        "ORDER BY message_id LIMIT :max_messages) chunk");
+    const QString today = currentDateSql();
+    QSqlQuery* aggregate_query = preparedQuery(
+        "INSERT INTO user_stats (user_id, message_count, public_count, private_count, last_active, stats_day, messages_today) "
+        "SELECT sender_id, COUNT(*), "
+        "COUNT(*) FILTER (WHERE type = 'public'), COUNT(*) FILTER (WHERE type = 'private'), "
+        "MAX(timestamp), " + today + ", COUNT(*) FILTER (WHERE timestamp >= " + today + ") "
+        "FROM " + all_messages + " WHERE message_id > :from_id AND message_id <= :to_id AND sender_id IS NOT NULL "
+        "GROUP BY sender_id "
+        "ON CONFLICT (user_id) DO UPDATE SET "
+        "message_count = user_stats.message_count + EXCLUDED.message_count, "
+        "public_count = user_stats.public_count + EXCLUDED.public_count, "
+        "private_count = user_stats.private_count + EXCLUDED.private_count, "
+        "last_active = " + dialect("GREATEST", "MAX") + "(user_stats.last_active, EXCLUDED.last_active), "
+        "messages_today = CASE WHEN user_stats.stats_day = " + today + " THEN user_stats.messages_today ELSE 0 END "
+        "+ EXCLUDED.messages_today, "
+        "stats_day = " + today);
+    QSqlQuery* advance_query = preparedQuery("UPDATE user_stats_watermark SET last_message_id = :to_id WHERE id");
+    if (!lock_query || !bound_query || !aggregate_query || !advance_query) return -1;
+
+    if (!handle.transaction()) {
+        qDebug() << "Error starting transaction:" << handle.lastError().text();
+        return -1;
+    }
+
+    auto fail = [&](QSqlQuery* query) {
+        qDebug() << "Error refreshing user stats:" << query->lastError().text();
+        query->finish();
+        handle.rollback();
+        return -1;
+    };
+
+    if (!execPrepared(*lock_query) || !lock_query->next()) return fail(lock_query);
+    int from_id = lock_query->value(0).toInt();
+    lock_query->finish();
+
+    bound_query->bindValue(":from_id", from_id);
+    bound_query->bindValue(":max_messages", maxMessages);
+    if (!execPrepared(*bound_query) || !bound_query->next()) return fail(bound_query);
+    int to_id = bound_query->value(0).toInt();
+    int chunk_messages = bound_query->value(1).toInt();
+    bound_query->finish();
+
+    if (to_id > from_id) {
+        aggregate_query->bindValue(":from_id", from_id);
+        aggregate_query->bindValue(":to_id", to_id);
+        if (!execPrepared(*aggregate_query)) return fail(aggregate_query);
+        aggregate_query->finish();
+
+        advance_query->bindValue(":to_id", to_id);
+        if (!execPrepared(*advance_query)) return fail(advance_query);
+        advance_query->finish();
+    }
+
+    if (!handle.commit()) {
+        qDebug() << "Error committing user stats:" << handle.lastError().text();
+        handle.rollback();
+        return -1;
+    }
+    return chunk_messages;
+}
+
+bool DatabaseManager::generateTestData(int userCount, int messageCount, const BulkProgress& progress) {
+    if (!isConnected()) return false;
+
+    QSqlQuery range(db);
+    if (!execSql(range, "SELECT COALESCE(MIN(user_id), 0), COALESCE(MAX(user_id), 0) FROM users") || !range.next()) {
+        qDebug() << "Error reading users range:" << range.lastError().text();
+        return false;
+    }
+    int first_user = range.value(0).toInt();
+    int last_user = range.value(1).toInt();
+    range.finish();
+
+    // Ряд чисел :from..:to и время "n секунд назад" в синтаксисе каждой СУБД
+    const QString series = dialect("generate_series(:from, :to) AS g(n)",
+        "(WITH RECURSIVE s(n) AS (SELECT :from UNION ALL SELECT n + 1 FROM s WHERE n < :to) SELECT n FROM s) AS g");
+    auto seconds_ago = [this](const QString& seconds) {
+        return dialect("CURRENT_TIMESTAMP - (" + seconds + ") * INTERVAL '1 second'",
+            "strftime('%Y-%m-%dT%H:%M:%f', 'now', 'localtime', '-' || (" + seconds + ") || ' seconds')");
+    };
+
+    // Пользователи получают id явно, сразу после существующих; отправители и получатели
+    // сообщений - детерминированная "случайная" выборка из диапазона пользователей
+    QSqlQuery* users_query = preparedQuery(
+        "INSERT INTO users (user_id, username, password_hash, registration_date, status) "
+        "SELECT n, 'load_user_' || n, 'load_test', " + seconds_ago("n % 31536000") + ", "
+        "CASE WHEN n % 97 = 0 THEN 'disconnected' ELSE 'active' END FROM " + series);
+    QSqlQuery* messages_query = preparedQuery(
+        "INSERT INTO messages (sender_id, receiver_id, message_text, timestamp, type) "
+        "SELECT :first_user + CAST(n AS BIGINT) * 7919 % :users, :first_user + CAST(n AS BIGINT) * 104729 % :users, "
+        "'Load test message ' || n || ': lorem ipsum dolor sit amet', " + seconds_ago("CAST(n AS BIGINT) * 7 % 15552000") + ", "
+        "CASE WHEN n % 4 = 0 THEN 'private' ELSE 'public' END FROM " + series);
+    if (!users_query || !messages_query) return false;
+
+    const int total = userCount + messageCount;
+    int done = 0;
+    auto run_chunks = [&](QSqlQuery* query, int from, int count, const QVariantMap& binds) {
+        for (int offset = 0; offset < count; offset += kGenerateChunkSize) {
+            int chunk = qMin(kGenerateChunkSize, count - offset);
+            if (!db.transaction()) {
+                qDebug() << "Error starting transaction:" << db.lastError().text();
+                return false;
+            }
+            query->bindValue(":from", from + offset);
+            query->bindValue(":to", from + offset + chunk - 1);
+            for (auto it = binds.constBegin(); it != binds.constEnd(); ++it) {
+                query->bindValue(it.key(), it.value());
+            }
+            bool ok = execPrepared(*query, "generate_test_data");
+            if (!ok) qDebug() << "Error generating test data:" << query->lastError().text();
+            query->finish();
+            if (!ok || !db.commit()) {
+                db.rollback();
+                return false;
+            }
+            done += chunk;
+            if (progress && !progress(done, total)) return false;
+        }
+        return true;
+    };
+
+    if (userCount > 0) {
+        if (!run_chunks(users_query, last_user + 1, userCount, QVariantMap())) return false;
+        if (postgres) {
+            // Явные id не двигают последовательность SERIAL
+            QSqlQuery sequence(db);
+            if (!execSql(sequence, "SELECT setval(pg_get_serial_sequence('users', 'user_id'), (SELECT MAX(user_id) FROM users))")) {
+                qDebug() << "Error advancing users sequence:" << sequence.lastError().text();
+            }
+        }
+        first_user = last_user + 1;
+        last_user += userCount;
+    }
+
+    if (messageCount > 0) {
+        if (last_user == 0) {
+            qDebug() << "No users to generate messages for.";
+            return false;
+        }
+        if (!run_chunks(messages_query, 1, messageCount,
+            { { ":first_user", first_user }, { ":users", last_user - first_user + 1 } })) return false;
+    }
+
+    loadUserStatuses();
+    return true;
+}
+
+bool DatabaseManager::execPrepared(QSqlQuery& query, const QString& label) {
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.exec();
+    recordQuery(query, label, timer.nsecsElapsed() / 1000, ok);
+    return ok;
+}
+
+bool DatabaseManager::execSql(QSqlQuery& query, const QString& sql, const QString& label) {
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = query.exec(sql);
+    recordQuery(query, label, timer.nsecsElapsed() / 1000, ok);
+    return ok;
+}
+
+void DatabaseManager::recordQuery(const QSqlQuery& query, const QString& label, qint64 elapsedUs, bool ok) {
+    // -1 - драйвер не знает числа строк (size() в SQLite и у курсоров): так и учитывается
+    qint64 rows = query.isSelect() ? query.size() : query.numRowsAffected();
+    query_stats.record(label.isEmpty() ? query.lastQuery() : label, elapsedUs, rows, ok);
+
+    if (elapsedUs >= kSlowQueryThresholdMs * 1000) {
+        QString entry;
+        QDebug(&entry).nospace() << QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss") << " "
+            << elapsedUs / 1000 << " ms, rows " << (rows >= 0 ? QString::number(rows) : QString("?")) << ": " << query.lastQuery()
+            << " params " << query.boundValues();
+        qWarning().noquote() << "Slow query:" << entry;
+        query_stats.recordSlow(entry);
+    }
+}
+
+QString DatabaseManager::queryStatsReport() const {
+    return query_stats.report();
+}
+
+void DatabaseManager::resetQueryStats() {
+    query_stats.reset();
+}
+
+UserStatus DatabaseManager::userStatus(int userId) const {
+    return status_cache.status(userId);
+}
+
+bool DatabaseManager::isUserBanned(int userId) const {
+    return status_cache.isBanned(userId, QDateTime::currentSecsSinceEpoch());
+}
+
+bool DatabaseManager::addMessage(int senderId, int receiverId, const QString& text, const QString& type) {
+    if (!isConnected()) return false;
+    if (isUserBanned(senderId)) {
+        qDebug() << "Message from banned user" << senderId << "rejected.";
+        return false;
+    }
+    QSqlQuery* query = preparedQuery("INSERT INTO messages (sender_id, receiver_id, message_text, type) VALUES (:sender_id, :receiver_id, :text, :type)");
+    if (!query) return false;
+    query->bindValue(":sender_id", senderId);
+    query->bindValue(":receiver_id", receiverId);
+    query->bindValue(":text", text);
+    query->bindValue(":type", type);
+
+    bool ok = execPrepared(*query);
+    if (ok) {
+        qDebug() << "Message added.";
+    }
+    else {
+        qDebug() << "Error adding message:" << query->lastError().text();
+    }
+    query->finish();
+    return ok;
+}
+
+bool DatabaseManager::deleteMessage(int messageId) {
+    if (!isConnected()) return false;
+    QSqlQuery* query = preparedQuery("DELETE FROM messages WHERE message_id = :message_id");
+    if (!query) return false;
+    query->bindValue(":message_id", messageId);
+
+    bool ok = execPrepared(*query);
+    if (ok) {
+        qDebug() << "Message" << messageId << "deleted.";
+    }
+    else {
+        qDebug() << "Error deleting message:" << query->lastError().text();
+    }
+    query->finish();
+    return ok;
+}
+
+// --- Реализация BanExpiryScheduler ---
+BanExpiryScheduler::BanExpiryScheduler(DatabaseManager* manager)
+    : QObject(manager), db_manager(manager)
+{
+    timer.setSingleShot(true);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &BanExpiryScheduler::on_timeout);
+}
+
+void BanExpiryScheduler::schedule(int userId, const QDateTime& endDate) {
+    if (QThread::currentThread() != thread()) {
+        // Таймер и куча принадлежат потоку планировщика (бан мог прийти из рабочего потока)
+        QMetaObject::invokeMethod(this, [=]() { schedule(userId, endDate); });
+        return;
+    }
+    if (!endDate.isValid()) return;
+    qint64 deadline = endDate.toMSecsSinceEpoch();
+    deadlines.insert(userId, deadline);
+    queue.push({ deadline, userId });
+    compact();
+    rearm();
+}
+
+void BanExpiryScheduler::cancel(int userId) {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() { cancel(userId); });
+        return;
+    }
+    // Запись в куче остается и будет пропущена при извлечении
+    deadlines.remove(userId);
+}
+
+void BanExpiryScheduler::clear() {
+    timer.stop();
+    deadlines.clear();
+    queue = decltype(queue)();
+}
+
+void BanExpiryScheduler::rearm() {
+    // Устаревшие записи на вершине не должны будить таймер
+    while (!queue.empty() && deadlines.value(queue.top().user_id, -1) != queue.top().deadline_ms) {
+        queue.pop();
+    }
+    if (queue.empty()) {
+        timer.stop();
+        return;
+    }
+    qint64 delay = queue.top().deadline_ms - QDateTime::currentMSecsSinceEpoch();
+    timer.start(static_cast<int>(qBound<qint64>(0, delay, kMaxTimerIntervalMs)));
+}
+
+void BanExpiryScheduler::compact() {
+    // Повторные баны оставляют в куче устаревшие записи; перестраиваем, когда их больше половины
+    if (queue.size() < 1024 || queue.size() <= 2 * static_cast<size_t>(deadlines.size())) return;
+
+    std::vector<Entry> entries;
+    entries.reserve(deadlines.size());
+    for (auto it = deadlines.constBegin(); it != deadlines.constEnd(); ++it) {
+        entries.push_back({ it.value(), it.key() });
+    }
+    queue = decltype(queue)(std::greater<Entry>(), std::move(entries));
+}
+
+void BanExpiryScheduler::on_timeout() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<int> expired;
+    while (!queue.empty() && queue.top().deadline_ms <= now) {
+        Entry entry = queue.top();
+        queue.pop();
+        auto it = deadlines.find(entry.user_id);
+        if (it != deadlines.end() && it.value() == entry.deadline_ms) {
+            expired << entry.user_id;
+            deadlines.erase(it);
+        }
+    }
+
+    if (!expired.isEmpty() && db_manager->liftExpiredBans(expired) < 0) {
+        // Записи уже удалены из deadlines - возвращаем их с отсрочкой, иначе баны не снимутся никогда
+        qint64 retry_at = now + kRetryIntervalMs;
+        for (int userId : expired) {
+            deadlines.insert(userId, retry_at);
+            queue.push({ retry_at, userId });
+        }
+    }
+    rearm();
+}
+
+// --- Реализация BanUserDialog ---
+BanUserDialog::BanUserDialog(QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle("Бан пользователя");
+    setModal(true);
+
+    QVBoxLayout* main_layout = new QVBoxLayout(this);
+
+    user_info_label = new QLabel("Бан пользователя: ", this);
+    main_layout->addWidget(user_info_label);
+
+    reason_label = new QLabel("Причина бана:", this);
+    main_layout->addWidget(reason_label);
+    reason_input = new QTextEdit(this);
+    reason_input->setPlaceholderText("Введите причину бана...");
+    reason_input->setFixedHeight(80);
+    main_layout->addWidget(reason_input);
+
+    ban_end_label = new QLabel("Срок бана:", this);
+    main_layout->addWidget(ban_end_label);
+    ban_end_datetime_edit = new QDateTimeEdit(this);
+    ban_end_datetime_edit->setCalendarPopup(true);
+    ban_end_datetime_edit->setMinimumDateTime(QDateTime::currentDateTime());
+    ban_end_datetime_edit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
+    connect(ban_end_datetime_edit, &QDateTimeEdit::dateTimeChanged, this, &BanUserDialog::update_ban_date_label);
+    update_ban_date_label();
+    main_layout->addWidget(ban_end_datetime_edit);
+
+    QHBoxLayout* buttons_layout = new QHBoxLayout();
+    ban_button = new QPushButton("Забанить", this);
+    cancel_button = new QPushButton("Отмена", this);
+    buttons_layout->addWidget(ban_button);
+    buttons_layout->addWidget(cancel_button);
+    main_layout->addLayout(buttons_layout);
+
+    connect(ban_button, &QPushButton::clicked, this, &BanUserDialog::on_ban_button_clicked);
+    connect(cancel_button, &QPushButton::clicked, this, &BanUserDialog::on_cancel_button_clicked);
+}
+
+void BanUserDialog::setUserId(int userId, const QString& username) {
+    setUserIds({ userId }, username + " (ID: " + QString::number(userId) + ")");
+}
+
+void BanUserDialog::setUserIds(const QList<int>& userIds, const QString& description) {
+    current_user_ids = userIds;
+    user_info_label->setText("Бан пользователя: " + description);
+    reason_input->clear();
+    ban_end_datetime_edit->setDateTime(QDateTime::currentDateTime().addDays(1));
+    update_ban_date_label();
+}
+
+void BanUserDialog::update_ban_date_label() {
+    if (ban_end_datetime_edit->dateTime().isValid()) {
+        ban_end_label->setText("Срок бана: до " + ban_end_datetime_edit->dateTime().toString("yyyy-MM-dd HH:mm:ss"));
+    }
+    else {
+        ban_end_label->setText("Срок бана: Неверная дата");
+    }
+}
+
+void BanUserDialog::on_ban_button_clicked() {
+    if (current_user_ids.isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Не выбран пользователь для бана.");
+        return;
+    }
+    QString reason = reason_input->toPlainText().trimmed();
+    QDateTime endDate = ban_end_datetime_edit->dateTime();
+
+    if (reason.isEmpty()) {
+        QMessageBox::warning(this, "Предупреждение", "Пожалуйста, укажите причину бана.");
+        return;
+    }
+    if (!endDate.isValid() || endDate <= QDateTime::currentDateTime()) {
+        QMessageBox::warning(this, "Предупреждение", "Дата окончания бана должна быть в будущем.");
+        return;
+    }
+
+    emit usersBanned(current_user_ids, reason, endDate);
+    close();
+}
+
+void BanUserDialog::on_cancel_button_clicked() {
+    close();
+}
+
+
+// --- Реализация LiveTableModel ---
+LiveTableModel::LiveTableModel(const QStringList& fields, const QString& keyField, QObject* parent)
+    : QAbstractTableModel(parent), field_names(fields), key_column(fields.indexOf(keyField)), headers(fields.size())
+{
+}
+
+int LiveTableModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int LiveTableModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : field_names.size();
+}
+
+QVariant LiveTableModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) return QVariant();
+    return rows[index.row()][index.column()];
+}
+
+QVariant LiveTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < headers.size()) {
+        return headers[section].isValid() ? headers[section] : QVariant(field_names[section]);
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool LiveTableModel::setHeaderData(int section, Qt::Orientation orientation, const QVariant& value, int role) {
+    if (orientation != Qt::Horizontal || section < 0 || section >= headers.size()) return false;
+    Q_UNUSED(role);
+    headers[section] = value;
+    emit headerDataChanged(orientation, section, section);
+    return true;
+}
+
+int LiveTableModel::fieldIndex(const QString& field) const {
+    return field_names.indexOf(field);
+}
+
+QSqlRecord LiveTableModel::record(int row) const {
+    QSqlRecord result;
+    for (int column = 0; column < field_names.size(); ++column) {
+        QSqlField field(field_names[column]);
+        if (row >= 0 && row < rows.size()) {
+            field.setValue(rows[row][column]);
+        }
+        result.append(field);
+    }
+    return result;
+}
+
+QVector<int> LiveTableModel::columnMapping(const QSqlQuery& query) const {
+    QSqlRecord query_record = query.record();
+    QVector<int> mapping(field_names.size());
+    for (int column = 0; column < field_names.size(); ++column) {
+        mapping[column] = query_record.indexOf(field_names[column]);
+    }
+    return mapping;
+}
+
+QVector<QVariant> LiveTableModel::readRow(const QSqlQuery& query, const QVector<int>& mapping) const {
+    QVector<QVariant> row(mapping.size());
+    for (int column = 0; column < mapping.size(); ++column) {
+        if (mapping[column] >= 0) row[column] = query.value(mapping[column]);
+    }
+    return row;
+}
+
+void LiveTableModel::reset(const PageLoader& loader) {
+    beginResetModel();
+    rows.clear();
+    row_by_key.clear();
+    max_key = 0;
+    page_loader = loader;
+    has_more = static_cast<bool>(loader);
+    endResetModel();
+    fetchMore(); // Первая страница сразу, остальные - по прокрутке
+}
+
+bool LiveTableModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && has_more;
+}
+
+void LiveTableModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid() || !has_more) return;
+    QSqlQuery query = page_loader(max_key, kPageSize);
+    if (!query.isActive()) {
+        has_more = false; // Ошибка уже в логе; повторять на каждой прокрутке незачем
+        return;
+    }
+
+    QVector<int> mapping = columnMapping(query);
+    QVector<QVector<QVariant>> page;
+    int fetched = 0;
+    while (query.next()) {
+        ++fetched;
+        QVector<QVariant> row = readRow(query, mapping);
+        qint64 key = row[key_column].toLongLong();
+        max_key = qMax(max_key, key);
+        if (row_by_key.contains(key)) continue;
+        row_by_key.insert(key, rows.size() + page.size());
+        page.append(row);
+    }
+    has_more = fetched == kPageSize;
+
+    if (!page.isEmpty()) {
+        beginInsertRows(QModelIndex(), rows.size(), rows.size() + page.size() - 1);
+        rows += page;
+        endInsertRows();
+    }
+}
+
+void LiveTableModel::upsert(QSqlQuery& query) {
+    QVector<int> mapping = columnMapping(query);
+    QVector<QVector<QVariant>> new_rows;
+
+    while (query.next()) {
+        QVector<QVariant> row = readRow(query, mapping);
+        qint64 key = row[key_column].toLongLong();
+        if (has_more && key > max_key) continue; // Придет со следующей страницей
+        max_key = qMax(max_key, key);
+
+        auto it = row_by_key.constFind(key);
+        if (it != row_by_key.constEnd()) {
+            // Строка уже есть - обновляем на месте
+            int row_index = it.value();
+            if (rows[row_index] != row) {
+                rows[row_index] = row;
+                emit dataChanged(index(row_index, 0), index(row_index, field_names.size() - 1));
+            }
+        }
+        else {
+            row_by_key.insert(key, rows.size() + new_rows.size());
+            new_rows.append(row);
+        }
+    }
+
+    // Новые строки добавляются в конец одной пачкой; порядок отображения задает прокси-модель
+    if (!new_rows.isEmpty()) {
+        beginInsertRows(QModelIndex(), rows.size(), rows.size() + new_rows.size() - 1);
+        rows += new_rows;
+        endInsertRows();
+    }
+}
+
+
+// --- Реализация ExportWorker ---
+ExportWorker::ExportWorker(DatabaseManager* manager, Table table, const QString& path)
+    : QObject(nullptr), db_manager(manager), table(table), path(path)
+{
+}
+
+void ExportWorker::cancel() {
+    canceled.store(true, std::memory_order_relaxed);
+}
+
+bool ExportWorker::openOutput() {
+    if (path.endsWith(".gz", Qt::CaseInsensitive)) {
+        gz = gzopen(QFile::encodeName(path).constData(), "wb6");
+        return gz != nullptr;
+    }
+    file.setFileName(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate);
 }
 
-// QSqlTableModel* DatabaseManager::getUsersModel() { /* ... (реализация ниже) ... */ return nullptr; }
-// QSqlTableModel* DatabaseManager::getMessagesModel() { /* ... (реализация ниже) ... */ return nullptr; }
+bool ExportWorker::writeOutput(const QByteArray& data) {
+    if (data.isEmpty()) return true;
+    if (gz) {
+        return gzwrite(gz, data.constData(), static_cast<unsigned>(data.size())) == data.size();
+    }
+    return file.write(data) == data.size();
+}
 
-bool DatabaseManager::setUserStatus(int userId, const QString& status) {
-    if (!isConnected()) return false;
-    QSqlQuery query;
-    query.prepare("UPDATE users SET status = :status WHERE user_id = :user_id");
-    query.bindValue(":status", status);
-    query.bindValue(":user_id", userId);
+bool ExportWorker::closeOutput() {
+    if (gz) {
+        bool ok = gzclose(gz) == Z_OK;
+        gz = nullptr;
+        return ok;
+    }
+    file.close();
+    return file.error() == QFileDevice::NoError;
+}
 
-    if (query.exec()) {
-        qDebug() << "User" << userId << "status set to" << status;
-        return true;
+void ExportWorker::appendCsvField(QByteArray& out, const QVariant& value) {
+    if (value.isNull()) return;
+    QByteArray text = value.userType() == QMetaType::QDateTime
+        ? value.toDateTime().toString(Qt::ISODateWithMs).toUtf8()
+        : value.toString().toUtf8();
+
+    // RFC 4180: кавычки только там, где они нужны
+    if (text.contains(',') || text.contains('"') || text.contains('\n') || text.contains('\r')) {
+        out += '"';
+        out += text.replace("\"", "\"\"");
+        out += '"';
     }
     else {
-        qDebug() << "Error setting user status:" << query.lastError().text();
-        return false;
+        out += text;
     }
 }
 
-bool DatabaseManager::banUser(int userId, const QString& reason, const QDateTime& endDate) {
-    if (!isConnected()) return false;
-    QSqlQuery query;
-    query.prepare("UPDATE users SET status = :status, ban_reason = :reason, ban_end_date = :end_date WHERE user_id = :user_id");
-    query.bindValue(":status", "banned");
-    query.bindValue(":reason", reason);
-    query.bindValue(":end_date", endDate);
-    query.bindValue(":user_id", userId);
+void ExportWorker::run() {
+    const QString table_name = table == Table::Users ? "users" : "messages";
+    const QString select = table == Table::Users
+        ? "SELECT user_id, username, status, registration_date, ban_reason, ban_end_date FROM users ORDER BY user_id"
+        : "SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM messages ORDER BY message_id";
 
-    if (query.exec()) {
-        qDebug() << "User" << userId << "banned until" << endDate;
-        return true;
+    if (!openOutput()) {
+        emit finished(false, 0, "Не удалось открыть файл " + path);
+        return;
+    }
+
+    qint64 estimated_total = db_manager->estimateRowCount(table_name);
+    qint64 rows = 0;
+    bool write_ok = true;
+    QByteArray buffer;
+    buffer.reserve(kFlushBytes + 64 * 1024);
+
+    bool ok = db_manager->streamQuery(select, kFetchBatchSize, [&](const QSqlQuery& row) {
+        QSqlRecord record = row.record();
+        if (rows == 0) {
+            // Заголовок по именам столбцов результата
+            for (int i = 0; i < record.count(); ++i) {
+                if (i > 0) buffer += ',';
+                buffer += record.fieldName(i).toUtf8();
+            }
+            buffer += "\r\n";
+        }
+        for (int i = 0; i < record.count(); ++i) {
+            if (i > 0) buffer += ',';
+            appendCsvField(buffer, row.value(i));
+        }
+        buffer += "\r\n";
+        ++rows;
+
+        if (buffer.size() >= kFlushBytes) {
+            write_ok = writeOutput(buffer);
+            buffer.clear();
+            emit progress(rows, estimated_total);
+        }
+        return write_ok && !canceled.load(std::memory_order_relaxed);
+    });
+
+    write_ok = write_ok && writeOutput(buffer);
+    write_ok = closeOutput() && write_ok;
+
+    if (canceled.load(std::memory_order_relaxed)) {
+        QFile::remove(path);
+        emit finished(false, rows, "Экспорт отменен.");
+    }
+    else if (!write_ok) {
+        emit finished(false, rows, "Ошибка записи в файл " + path);
+    }
+    else if (!ok) {
+        emit finished(false, rows, "Ошибка чтения из базы данных. Проверьте логи сервера.");
     }
     else {
-        qDebug() << "Error banning user:" << query.lastError().text();
-        return false;
+        emit progress(rows, rows);
+        emit finished(true, rows, QString());
     }
 }
 
-bool DatabaseManager::unbanUser(int userId) {
-    return setUserStatus(userId, "active");
+
+// --- Реализация RetentionJob ---
+RetentionJob::RetentionJob(DatabaseManager* manager, int retentionDays)
+    : QObject(nullptr), db_manager(manager), retention_days(retentionDays)
+{
 }
 
-bool DatabaseManager::addMessage(int senderId, int receiverId, const QString& text, const QString& type) {
-    if (!isConnected()) return false;
-    QSqlQuery query;
-    query.prepare("INSERT INTO messages (sender_id, receiver_id, message_text, type) VALUES (:sender_id, :receiver_id, :text, :type)");
-    query.bindValue(":sender_id", senderId);
-    query.bindValue(":receiver_id", receiverId);
-    query.bindValue(":text", text);
-    query.bindValue(":type", type);
+void RetentionJob::start() {
+    timer = new QTimer(this); // Создается в потоке задания
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &RetentionJob::run_batch);
+    timer->start(0);
+}
 
-    if (query.exec()) {
-        qDebug() << "Message added.";
-        return true;
-    }
-    else {
-        qDebug() << "Error adding message:" << query.lastError().text();
-        return false;
-    }
+void RetentionJob::stop() {
+    if (timer) timer->stop();
 }
 
-bool DatabaseManager::deleteMessage(int messageId) {
-    if (!isConnected()) return false;
-    QSqlQuery query;
-    query.prepare("DELETE FROM messages WHERE message_id = :message_id");
-    query.bindValue(":message_id", messageId);
+void RetentionJob::run_batch() {
+    QDateTime cutoff = QDateTime::currentDateTime().addDays(-retention_days);
+    int moved = db_manager->archiveMessagesBatch(cutoff, kBatchSize);
 
-    if (query.exec()) {
-        qDebug() << "Message" << messageId << "deleted.";
-        return true;
+    if (moved < 0) {
+        timer->start(kRetryIntervalMs);
+        return;
     }
-    else {
-        qDebug() << "Error deleting message:" << query.lastError().text();
-        return false;
+    if (moved > 0) {
+        qDebug() << "Archived messages:" << moved;
+        emit batchArchived(moved);
     }
+    // Полная пачка - вероятно, есть еще; иначе ждем, пока сообщения состарятся
+    timer->start(moved == kBatchSize ? kBatchPauseMs : kIdleIntervalMs);
 }
 
-// --- Реализация BanUserDialog ---
-BanUserDialog::BanUserDialog(QWidget* parent)
-    : QDialog(parent), current_user_id(0)
+
+// --- Реализация UserStatsJob ---
+UserStatsJob::UserStatsJob(DatabaseManager* manager)
+    : QObject(nullptr), db_manager(manager)
 {
-    setWindowTitle("Бан пользователя");
-    setModal(true);
+}
 
-    QVBoxLayout* main_layout = new QVBoxLayout(this);
+void UserStatsJob::start() {
+    timer = new QTimer(this); // Создается в потоке задания
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &UserStatsJob::run_refresh);
+    timer->start(0);
+}
 
-    user_info_label = new QLabel("Бан пользователя: ", this);
-    main_layout->addWidget(user_info_label);
+void UserStatsJob::run_refresh() {
+    int processed = db_manager->refreshUserStats(kChunkMessages);
+    if (processed > 0) {
+        emit statsUpdated();
+    }
+    // Полный кусок - отстаем от истории, продолжаем почти сразу
+    timer->start(processed >= kChunkMessages ? kCatchUpPauseMs : kIntervalMs);
+}
 
-    reason_label = new QLabel("Причина бана:", this);
-    main_layout->addWidget(reason_label);
-    reason_input = new QTextEdit(this);
-    reason_input->setPlaceholderText("Введите причину бана...");
-    reason_input->setFixedHeight(80);
-    main_layout->addWidget(reason_input);
 
-    ban_end_label = new QLabel("Срок бана:", this);
-    main_layout->addWidget(ban_end_label);
-    ban_end_datetime_edit = new QDateTimeEdit(this);
-    ban_end_datetime_edit->setCalendarPopup(true);
-    ban_end_datetime_edit->setMinimumDateTime(QDateTime::currentDateTime());
-    ban_end_datetime_edit->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
-    connect(ban_end_datetime_edit, &QDateTimeEdit::dateTimeChanged, this, &BanUserDialog::update_ban_date_label);
-    update_ban_date_label();
-    main_layout->addWidget(ban_end_datetime_edit);
+// --- Реализация AdminDataService ---
+AdminDataService::AdminDataService(DatabaseManager* manager) : db_manager(manager) {
+}
 
-    QHBoxLayout* buttons_layout = new QHBoxLayout();
-    ban_button = new QPushButton("Забанить", this);
-    cancel_button = new QPushButton("Отмена", this);
-    buttons_layout->addWidget(ban_button);
-    buttons_layout->addWidget(cancel_button);
-    main_layout->addLayout(buttons_layout);
+QStringList AdminDataService::userFields() {
+    return { "user_id", "username", "status", "registration_date", "ban_reason", "ban_end_date",
+             "message_count", "messages_today", "last_active", "public_ratio" };
+}
 
-    connect(ban_button, &QPushButton::clicked, this, &BanUserDialog::on_ban_button_clicked);
-    connect(cancel_button, &QPushButton::clicked, this, &BanUserDialog::on_cancel_button_clicked);
+QStringList AdminDataService::messageFields() {
+    return { "message_id", "sender_id", "receiver_id", "message_text", "timestamp", "type" };
 }
 
-void BanUserDialog::setUserId(int userId, const QString& username) {
-    current_user_id = userId;
-    current_username = username;
-    user_info_label->setText("Бан пользователя: " + username + " (ID: " + QString::number(userId) + ")");
-    reason_input->clear();
-    ban_end_datetime_edit->setDateTime(QDateTime::currentDateTime().addDays(1));
-    update_ban_date_label();
+// Пользователи вместе с предрасчитанной статистикой (соединение по первичному ключу,
+// без агрегации по messages)
+QString AdminDataService::usersSelect(const QString& condition) const {
+    QString sql = "SELECT u.user_id, u.username, u.status, u.registration_date, u.ban_reason, u.ban_end_date, "
+        "COALESCE(s.message_count, 0) AS message_count, "
+        "CASE WHEN s.stats_day = " + db_manager->currentDateSql() + " THEN s.messages_today ELSE 0 END AS messages_today, "
+        "s.last_active, "
+        "CAST(s.public_count AS DOUBLE PRECISION) / NULLIF(s.message_count, 0) AS public_ratio "
+        "FROM users u LEFT JOIN user_stats s ON s.user_id = u.user_id";
+    if (!condition.isEmpty()) {
+        sql += " WHERE " + condition;
+    }
+    return sql;
 }
 
-void BanUserDialog::update_ban_date_label() {
-    if (ban_end_datetime_edit->dateTime().isValid()) {
-        ban_end_label->setText("Срок бана: до " + ban_end_datetime_edit->dateTime().toString("yyyy-MM-dd HH:mm:ss"));
+QSqlQuery AdminDataService::selectUsers(qint64 afterUserId, int limit) {
+    QString sql = usersSelect(afterUserId > 0 ? "u.user_id > :last_id" : QString()) + " ORDER BY u.user_id";
+    if (limit > 0) sql += " LIMIT " + QString::number(limit);
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    if (afterUserId > 0) query.bindValue(":last_id", afterUserId);
+    if (!db_manager->execPrepared(query, "load_users")) {
+        qDebug() << "Error loading users:" << query.lastError().text();
     }
-    else {
-        ban_end_label->setText("Срок бана: Неверная дата");
+    return query;
+}
+
+QSqlQuery AdminDataService::selectNewUsers(qint64 afterUserId) {
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(usersSelect("u.user_id > :last_id"));
+    query.bindValue(":last_id", afterUserId);
+    if (!db_manager->execPrepared(query, "load_new_users")) {
+        qDebug() << "Error loading users:" << query.lastError().text();
     }
+    return query;
 }
 
-void BanUserDialog::on_ban_button_clicked() {
-    if (current_user_id == 0) {
-        QMessageBox::warning(this, "Ошибка", "Не выбран пользователь для бана.");
-        return;
+QSqlQuery AdminDataService::selectUserRows(const QList<int>& userIds) {
+    QStringList ids;
+    for (int id : userIds) ids << QString::number(id);
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!db_manager->execSql(query, usersSelect("u.user_id IN (" + ids.join(",") + ")"), "load_user_rows")) {
+        qDebug() << "Error loading users:" << query.lastError().text();
     }
-    QString reason = reason_input->toPlainText().trimmed();
-    QDateTime endDate = ban_end_datetime_edit->dateTime();
+    return query;
+}
 
-    if (reason.isEmpty()) {
-        QMessageBox::warning(this, "Предупреждение", "Пожалуйста, укажите причину бана.");
-        return;
+// Выборка сообщений с учетом фильтров (текст + тип); afterMessageId > 0 - только новее
+QSqlQuery AdminDataService::selectMessages(const MessageFilter& filter, qint64 afterMessageId, int limit) {
+    QString query_string = "SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM ";
+    if (filter.include_archive) {
+        query_string += "(SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM messages "
+            "UNION ALL "
+            "SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM messages_archive) AS all_messages";
     }
-    if (!endDate.isValid() || endDate <= QDateTime::currentDateTime()) {
-        QMessageBox::warning(this, "Предупреждение", "Дата окончания бана должна быть в будущем.");
-        return;
+    else {
+        query_string += "messages";
+    }
+    QStringList conditions;
+    QVariantMap binds;
+
+    // Фильтр по тексту (параметром, с экранированием спецсимволов LIKE).
+    // В SQLite ILIKE нет, а LIKE и так не различает регистр (для ASCII).
+    if (!filter.text.isEmpty()) {
+        QString pattern = filter.text;
+        pattern.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+        conditions << QString("message_text %1 :filter_text ESCAPE '\\'").arg(db_manager->isPostgres() ? "ILIKE" : "LIKE");
+        binds[":filter_text"] = "%" + pattern + "%";
     }
 
-    emit userBanned(current_user_id, reason, endDate);
-    close();
+    // Фильтр по типу
+    if (filter.type == MessageFilter::Type::Public) {
+        conditions << "type = 'public'";
+    }
+    else if (filter.type == MessageFilter::Type::Private) {
+        conditions << "type = 'private'";
+    }
+
+    if (afterMessageId > 0) {
+        conditions << "message_id > :last_id";
+        binds[":last_id"] = afterMessageId;
+    }
+    if (!conditions.isEmpty()) {
+        query_string += " WHERE " + conditions.join(" AND ");
+    }
+    query_string += " ORDER BY message_id";
+    if (limit > 0) query_string += " LIMIT " + QString::number(limit);
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare(query_string);
+    for (auto it = binds.constBegin(); it != binds.constEnd(); ++it) {
+        query.bindValue(it.key(), it.value());
+    }
+    if (!db_manager->execPrepared(query, afterMessageId > 0 && limit == 0 ? "load_new_messages" : "select_messages")) {
+        qDebug() << "Error loading messages:" << query.lastError().text();
+    }
+    return query;
 }
 
-void BanUserDialog::on_cancel_button_clicked() {
-    close();
+
+// --- Реализация AdminBenchmark ---
+AdminBenchmark::AdminBenchmark(const DatabaseConfig& config, const QStringList& arguments)
+    : config(config), out(stdout)
+{
+    // Без явного выбора бэкенда - база в памяти, чтобы не засорить рабочую БД
+    bool explicit_backend = false;
+    for (const QString& arg : arguments) {
+        if (arg == "--sqlite" || arg == "--memory" || arg.startsWith("--pg-")) explicit_backend = true;
+    }
+    if (!explicit_backend) this->config.backend = DatabaseConfig::Backend::SqliteMemory;
+
+    switch (this->config.backend) {
+    case DatabaseConfig::Backend::Postgres: backend_name = "postgres"; break;
+    case DatabaseConfig::Backend::SqliteFile: backend_name = "sqlite-file"; break;
+    case DatabaseConfig::Backend::SqliteMemory: backend_name = "sqlite-memory"; break;
+    }
+
+    int sizes_index = arguments.indexOf("--benchmark-sizes");
+    if (sizes_index >= 0 && sizes_index + 1 < arguments.size()) {
+        dataset_sizes.clear();
+        for (const QString& size : arguments.at(sizes_index + 1).split(',', Qt::SkipEmptyParts)) {
+            dataset_sizes << size.toLongLong();
+        }
+        std::sort(dataset_sizes.begin(), dataset_sizes.end()); // Данные только добавляются
+    }
+    int repeats_index = arguments.indexOf("--benchmark-repeats");
+    if (repeats_index >= 0 && repeats_index + 1 < arguments.size()) {
+        repeats = qMax(1, arguments.at(repeats_index + 1).toInt());
+    }
 }
 
+int AdminBenchmark::run() {
+    DatabaseManager manager(config);
+    if (!manager.connectToDatabase()) {
+        qWarning() << "Benchmark: database connection failed.";
+        return 1;
+    }
+    AdminDataService service(&manager);
+    db_manager = &manager;
+    data_service = &service;
+
+    const QList<FilterCase> filter_cases = {
+        { "text", { "message 4242:", AdminDataService::MessageFilter::Type::All, false } },
+        { "type", { QString(), AdminDataService::MessageFilter::Type::Private, false } },
+        { "text_type_archive", { "lorem", AdminDataService::MessageFilter::Type::Public, true } }
+    };
+
+    qint64 messages = qMax<qint64>(manager.estimateRowCount("messages"), 0);
+    for (qint64 size : dataset_sizes) {
+        if (size > messages) {
+            // Один пользователь на десять сообщений
+            qint64 add = size - messages;
+            QElapsedTimer timer;
+            timer.start();
+            if (!manager.generateTestData(static_cast<int>(qMax<qint64>(add / 10, 1)), static_cast<int>(add))) {
+                qWarning() << "Benchmark: test data generation failed.";
+                return 1;
+            }
+            qint64 elapsed_ms = qMax<qint64>(timer.elapsed(), 1);
+            report(size, "generate", elapsed_ms, "ms");
+            report(size, "generate_rate", add * 1000.0 / elapsed_ms, "rows/s");
+            messages = size;
+        }
+
+        measureLoad(size, "users", AdminDataService::userFields(), "user_id",
+            [&](qint64 afterKey, int limit) { return service.selectUsers(afterKey, limit); });
+        measureLoad(size, "messages", AdminDataService::messageFields(), "message_id",
+            [&](qint64 afterKey, int limit) { return service.selectMessages(AdminDataService::MessageFilter(), afterKey, limit); });
+        for (const FilterCase& filter_case : filter_cases) {
+            measureFilter(size, filter_case);
+        }
+    }
 
-// --- Реализация ServerMainWindow ---
-ServerMainWindow::ServerMainWindow(QWidget* parent)
-    : QMainWindow(parent), db_manager(nullptr), ban_dialog(nullptr)
+    // Сводка по операторам - в stderr, чтобы не мешать разбору stdout
+    QTextStream(stderr) << manager.queryStatsReport();
+    manager.disconnectFromDatabase();
+    return 0;
+}
+
+void AdminBenchmark::report(qint64 datasetRows, const QString& metric, double value, const QString& unit) {
+    QJsonObject result;
+    result["backend"] = backend_name;
+    result["dataset_rows"] = datasetRows;
+    result["metric"] = metric;
+    result["value"] = value;
+    result["unit"] = unit;
+    out << QJsonDocument(result).toJson(QJsonDocument::Compact) << "\n";
+    out.flush();
+}
+
+// Загрузка в LiveTableModel: первая страница, как при открытии вкладки, затем
+// прокрутка до конца - время и прирост памяти процесса при всех загруженных строках
+void AdminBenchmark::measureLoad(qint64 datasetRows, const QString& name, const QStringList& fields, const QString& keyField,
+    const LiveTableModel::PageLoader& loader)
 {
-    db_manager = new DatabaseManager();
-    if (!db_manager->connectToDatabase()) {
-        QMessageBox::critical(this, "Ошибка базы данных", "Не удалось подключиться к базе данных. Убедитесь, что PostgreSQL запущен и настроен. Проверьте имя пользователя, пароль и имя базы данных в DatabaseManager.");
-        qApp->quit(); // Закрываем приложение, если нет БД
-        return;
+    qint64 rss_before = residentMemoryKb();
+    LiveTableModel model(fields, keyField);
+
+    QElapsedTimer timer;
+    timer.start();
+    model.reset(loader);
+    report(datasetRows, name + "_first_page", timer.nsecsElapsed() / 1e6, "ms");
+
+    timer.restart();
+    while (model.canFetchMore()) model.fetchMore();
+    report(datasetRows, name + "_populate", timer.nsecsElapsed() / 1e6, "ms");
+    report(datasetRows, name + "_model_rows", model.rowCount(), "rows");
+
+    qint64 rss_after = residentMemoryKb();
+    if (rss_before >= 0 && rss_after >= 0) {
+        report(datasetRows, name + "_model_memory", rss_after - rss_before, "KiB");
+    }
+}
+
+// Задержка фильтрующего запроса до последней строки результата: медиана и максимум из repeats
+void AdminBenchmark::measureFilter(qint64 datasetRows, const FilterCase& filterCase) {
+    QVector<double> samples;
+    qint64 rows = 0;
+    for (int i = 0; i < repeats; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        QSqlQuery query = data_service->selectMessages(filterCase.filter);
+        if (!query.isActive()) return;
+        rows = 0;
+        while (query.next()) ++rows;
+        samples << timer.nsecsElapsed() / 1e6;
+    }
+    std::sort(samples.begin(), samples.end());
+    report(datasetRows, "filter_" + filterCase.name + "_p50", samples.at(samples.size() / 2), "ms");
+    report(datasetRows, "filter_" + filterCase.name + "_max", samples.last(), "ms");
+    report(datasetRows, "filter_" + filterCase.name + "_rows", rows, "rows");
+}
+
+qint64 AdminBenchmark::residentMemoryKb() {
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) return -1;
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
     }
+    return -1;
+}
 
+
+// --- Реализация ServerMainWindow ---
+ServerMainWindow::ServerMainWindow(DatabaseManager* manager, QWidget* parent)
+    : QMainWindow(parent), db_manager(manager), data_service(manager), ban_dialog(nullptr), live_poll_timer(nullptr), live_apply_timer(nullptr), maintenance_thread(nullptr)
+{
     setup_ui();
     load_users();
     load_messages();
+
+    // Живое обновление: уведомления PostgreSQL, иначе (и в SQLite) опрос "строки новее последней увиденной"
+    live_apply_timer = new QTimer(this);
+    live_apply_timer->setSingleShot(true);
+    live_apply_timer->setInterval(100);
+    connect(live_apply_timer, &QTimer::timeout, this, &ServerMainWindow::apply_live_updates);
+
+    connect(db_manager, &DatabaseManager::bansExpired, this, &ServerMainWindow::load_user_rows);
+
+    if (db_manager->subscribeToChanges()) {
+        connect(db_manager, &DatabaseManager::usersChanged, this, &ServerMainWindow::on_users_changed);
+        connect(db_manager, &DatabaseManager::messageInserted, this, &ServerMainWindow::on_message_inserted);
+    }
+    else {
+        live_poll_timer = new QTimer(this);
+        live_poll_timer->setInterval(1000);
+        connect(live_poll_timer, &QTimer::timeout, this, &ServerMainWindow::poll_live_updates);
+        live_poll_timer->start();
+    }
+
+    // Фоновое обслуживание: архивирование старых сообщений и статистика пользователей
+    maintenance_thread = new QThread(this);
+    RetentionJob* retention_job = new RetentionJob(db_manager, kMessageRetentionDays);
+    retention_job->moveToThread(maintenance_thread);
+    connect(maintenance_thread, &QThread::started, retention_job, &RetentionJob::start);
+    connect(maintenance_thread, &QThread::finished, retention_job, &QObject::deleteLater);
+    UserStatsJob* stats_job = new UserStatsJob(db_manager);
+    stats_job->moveToThread(maintenance_thread);
+    connect(maintenance_thread, &QThread::started, stats_job, &UserStatsJob::start);
+    connect(maintenance_thread, &QThread::finished, stats_job, &QObject::deleteLater);
+    maintenance_thread->start(QThread::LowPriority);
 }
 
 ServerMainWindow::~ServerMainWindow() {
+    if (maintenance_thread) {
+        // Каждый шаг заданий - одна транзакция, так что останавливать можно в любой момент
+        maintenance_thread->quit();
+        maintenance_thread->wait();
+    }
     if (db_manager) {
         db_manager->disconnectFromDatabase();
         delete db_manager;
@@ -442,26 +2743,28 @@ void ServerMainWindow::setup_ui() {
     users_layout->addWidget(users_search_filter);
 
     users_table = new QTableView(users_tab);
-    users_sql_model = new QSqlTableModel(users_table);
-    users_sql_model->setTable("users");
-    users_sql_model->setEditStrategy(QSqlTableModel::OnManualSubmit); // Ручное сохранение, если будет редактирование
-    users_sql_model->select();
+    users_model = new LiveTableModel(AdminDataService::userFields(), "user_id", users_table);
 
-    users_sql_model->setHeaderData(users_sql_model->fieldIndex("user_id"), Qt::Horizontal, "ID");
-    users_sql_model->setHeaderData(users_sql_model->fieldIndex("username"), Qt::Horizontal, "Имя пользователя");
-    users_sql_model->setHeaderData(users_sql_model->fieldIndex("status"), Qt::Horizontal, "Статус");
-    users_sql_model->setHeaderData(users_sql_model->fieldIndex("registration_date"), Qt::Horizontal, "Дата регистрации");
-    users_sql_model->setHeaderData(users_sql_model->fieldIndex("ban_reason"), Qt::Horizontal, "Причина бана");
-    users_sql_model->setHeaderData(users_sql_model->fieldIndex("ban_end_date"), Qt::Horizontal, "Конец бана");
+    users_model->setHeaderData(users_model->fieldIndex("user_id"), Qt::Horizontal, "ID");
+    users_model->setHeaderData(users_model->fieldIndex("username"), Qt::Horizontal, "Имя пользователя");
+    users_model->setHeaderData(users_model->fieldIndex("status"), Qt::Horizontal, "Статус");
+    users_model->setHeaderData(users_model->fieldIndex("registration_date"), Qt::Horizontal, "Дата регистрации");
+    users_model->setHeaderData(users_model->fieldIndex("ban_reason"), Qt::Horizontal, "Причина бана");
+    users_model->setHeaderData(users_model->fieldIndex("ban_end_date"), Qt::Horizontal, "Конец бана");
+    users_model->setHeaderData(users_model->fieldIndex("message_count"), Qt::Horizontal, "Сообщений");
+    users_model->setHeaderData(users_model->fieldIndex("messages_today"), Qt::Horizontal, "Сегодня");
+    users_model->setHeaderData(users_model->fieldIndex("last_active"), Qt::Horizontal, "Последняя активность");
+    users_model->setHeaderData(users_model->fieldIndex("public_ratio"), Qt::Horizontal, "Доля публичных");
 
 
     users_proxy_model = new QSortFilterProxyModel(users_table);
-    users_proxy_model->setSourceModel(users_sql_model);
-    users_proxy_model->setFilterKeyColumn(users_sql_model->fieldIndex("username"));
+    users_proxy_model->setSourceModel(users_model);
+    users_proxy_model->setFilterKeyColumn(users_model->fieldIndex("username"));
     users_table->setModel(users_proxy_model);
     users_table->setSortingEnabled(true);
+    users_table->sortByColumn(users_model->fieldIndex("username"), Qt::AscendingOrder);
     users_table->setSelectionBehavior(QAbstractItemView::SelectRows);
-    users_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    users_table->setSelectionMode(QAbstractItemView::ExtendedSelection);
     users_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
     users_table->horizontalHeader()->setStretchLastSection(true);
     users_table->verticalHeader()->setVisible(false);
@@ -474,6 +2777,9 @@ void ServerMainWindow::setup_ui() {
     ban_user_button = new QPushButton("Забанить");
     unban_user_button = new QPushButton("Разбанить");
     disconnect_user_button = new QPushButton("Отключить");
+    apply_to_matching_check = new QCheckBox("Ко всем найденным");
+    apply_to_matching_check->setToolTip("Применить действие ко всем пользователям, подходящим под фильтр поиска");
+    export_users_button = new QPushButton("Экспорт...");
 
     ban_user_button->setEnabled(false);
     unban_user_button->setEnabled(false);
@@ -483,7 +2789,9 @@ void ServerMainWindow::setup_ui() {
     user_buttons_layout->addWidget(ban_user_button);
     user_buttons_layout->addWidget(unban_user_button);
     user_buttons_layout->addWidget(disconnect_user_button);
+    user_buttons_layout->addWidget(apply_to_matching_check);
     user_buttons_layout->addStretch();
+    user_buttons_layout->addWidget(export_users_button);
     users_layout->addLayout(user_buttons_layout);
 
     tab_widget->addTab(users_tab, "Пользователи");
@@ -501,22 +2809,22 @@ void ServerMainWindow::setup_ui() {
     messages_filter_combo->addItem("Приватные");
     message_filter_layout->addWidget(messages_search_filter);
     message_filter_layout->addWidget(messages_filter_combo);
+    messages_include_archive_check = new QCheckBox("Включая архив", messages_tab);
+    message_filter_layout->addWidget(messages_include_archive_check);
     messages_layout->addLayout(message_filter_layout);
 
     messages_table = new QTableView(messages_tab);
-    messages_sql_model = new QSqlTableModel(messages_table);
-    messages_sql_model->setTable("messages");
-    messages_sql_model->select();
+    messages_model = new LiveTableModel(AdminDataService::messageFields(), "message_id", messages_table);
 
-    messages_sql_model->setHeaderData(messages_sql_model->fieldIndex("message_id"), Qt::Horizontal, "ID");
-    messages_sql_model->setHeaderData(messages_sql_model->fieldIndex("sender_id"), Qt::Horizontal, "Отправитель");
-    messages_sql_model->setHeaderData(messages_sql_model->fieldIndex("receiver_id"), Qt::Horizontal, "Получатель");
-    messages_sql_model->setHeaderData(messages_sql_model->fieldIndex("message_text"), Qt::Horizontal, "Сообщение");
-    messages_sql_model->setHeaderData(messages_sql_model->fieldIndex("timestamp"), Qt::Horizontal, "Время");
-    messages_sql_model->setHeaderData(messages_sql_model->fieldIndex("type"), Qt::Horizontal, "Тип");
+    messages_model->setHeaderData(messages_model->fieldIndex("message_id"), Qt::Horizontal, "ID");
+    messages_model->setHeaderData(messages_model->fieldIndex("sender_id"), Qt::Horizontal, "Отправитель");
+    messages_model->setHeaderData(messages_model->fieldIndex("receiver_id"), Qt::Horizontal, "Получатель");
+    messages_model->setHeaderData(messages_model->fieldIndex("message_text"), Qt::Horizontal, "Сообщение");
+    messages_model->setHeaderData(messages_model->fieldIndex("timestamp"), Qt::Horizontal, "Время");
+    messages_model->setHeaderData(messages_model->fieldIndex("type"), Qt::Horizontal, "Тип");
 
     messages_proxy_model = new QSortFilterProxyModel(messages_tab);
-    messages_proxy_model->setSourceModel(messages_sql_model);
+    messages_proxy_model->setSourceModel(messages_model);
 
     connect(messages_search_filter, &QLineEdit::textChanged, this, [this]() {
         // Нужно обновлять фильтр сообщения, когда меняется текст, но это сложно сделать
@@ -526,9 +2834,11 @@ void ServerMainWindow::setup_ui() {
         });
     connect(messages_filter_combo, QOverload<int>::of(&QComboBox::currentIndexChanged),
         this, &ServerMainWindow::apply_message_filters);
+    connect(messages_include_archive_check, &QCheckBox::toggled, this, &ServerMainWindow::apply_message_filters);
 
     messages_table->setModel(messages_proxy_model);
     messages_table->setSortingEnabled(true);
+    messages_table->sortByColumn(messages_model->fieldIndex("timestamp"), Qt::DescendingOrder); // Новые сверху
     messages_table->setSelectionBehavior(QAbstractItemView::SelectRows);
     messages_table->setSelectionMode(QAbstractItemView::SingleSelection);
     messages_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -539,31 +2849,64 @@ void ServerMainWindow::setup_ui() {
 
     QHBoxLayout* message_buttons_layout = new QHBoxLayout();
     refresh_messages_button = new QPushButton("Обновить сообщения");
+    export_messages_button = new QPushButton("Экспорт...");
     message_buttons_layout->addWidget(refresh_messages_button);
     message_buttons_layout->addStretch();
+    message_buttons_layout->addWidget(export_messages_button);
     messages_layout->addLayout(message_buttons_layout);
 
     tab_widget->addTab(messages_tab, "Сообщения");
 
+    // --- Вкладка Запросы ---
+    query_stats_tab = new QWidget();
+    QVBoxLayout* query_stats_layout = new QVBoxLayout(query_stats_tab);
+
+    query_stats_view = new QTextEdit();
+    query_stats_view->setReadOnly(true);
+    query_stats_view->setLineWrapMode(QTextEdit::NoWrap);
+    query_stats_view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    query_stats_layout->addWidget(query_stats_view);
+
+    QHBoxLayout* query_stats_buttons_layout = new QHBoxLayout();
+    refresh_query_stats_button = new QPushButton("Обновить");
+    reset_query_stats_button = new QPushButton("Сбросить");
+    query_stats_buttons_layout->addWidget(refresh_query_stats_button);
+    query_stats_buttons_layout->addWidget(reset_query_stats_button);
+    query_stats_buttons_layout->addStretch();
+    query_stats_layout->addLayout(query_stats_buttons_layout);
+
+    tab_widget->addTab(query_stats_tab, "Запросы");
+
     // --- Подключение сигналов и слотов ---
     connect(users_search_filter, &QLineEdit::textChanged, this, [this]() {
         users_proxy_model->setFilterFixedString(users_search_filter->text());
         });
     connect(users_table->selectionModel(), &QItemSelectionModel::selectionChanged, this, &ServerMainWindow::on_user_selection_changed);
+    connect(apply_to_matching_check, &QCheckBox::toggled, this, &ServerMainWindow::on_user_selection_changed);
+    connect(users_proxy_model, &QSortFilterProxyModel::layoutChanged, this, &ServerMainWindow::on_user_selection_changed);
     connect(refresh_users_button, &QPushButton::clicked, this, &ServerMainWindow::refresh_user_list);
     connect(ban_user_button, &QPushButton::clicked, this, &ServerMainWindow::on_ban_user_button_clicked);
     connect(unban_user_button, &QPushButton::clicked, this, &ServerMainWindow::on_unban_user_button_clicked);
     connect(disconnect_user_button, &QPushButton::clicked, this, &ServerMainWindow::on_disconnect_user_button_clicked);
     connect(refresh_messages_button, &QPushButton::clicked, this, &ServerMainWindow::refresh_message_list);
     connect(users_table, &QTableView::doubleClicked, this, &ServerMainWindow::on_user_table_double_clicked);
+    connect(export_users_button, &QPushButton::clicked, this, &ServerMainWindow::on_export_users_button_clicked);
+    connect(export_messages_button, &QPushButton::clicked, this, &ServerMainWindow::on_export_messages_button_clicked);
+    connect(refresh_query_stats_button, &QPushButton::clicked, this, &ServerMainWindow::refresh_query_stats);
+    connect(reset_query_stats_button, &QPushButton::clicked, this, [this]() {
+        db_manager->resetQueryStats();
+        refresh_query_stats();
+        });
+    connect(tab_widget, &QTabWidget::currentChanged, this, [this](int index) {
+        if (tab_widget->widget(index) == query_stats_tab) refresh_query_stats();
+        });
 
     ban_dialog = new BanUserDialog(this);
-    connect(ban_dialog, &BanUserDialog::userBanned, this, &ServerMainWindow::process_ban_user_dialog);
+    connect(ban_dialog, &BanUserDialog::usersBanned, this, &ServerMainWindow::process_ban_user_dialog);
 }
 
 void ServerMainWindow::load_users() {
-    users_sql_model->setQuery("SELECT user_id, username, status, registration_date, ban_reason, ban_end_date FROM users ORDER BY username");
-    users_sql_model->select(); // Повторное выполнение запроса, если нужно обновить данные
+    users_model->reset([this](qint64 afterKey, int limit) { return data_service.selectUsers(afterKey, limit); });
     on_user_selection_changed();
     users_table->resizeColumnsToContents();
 }
@@ -583,144 +2926,297 @@ void ServerMainWindow::refresh_message_list() {
     qDebug() << "Список сообщений обновлен.";
 }
 
-void ServerMainWindow::apply_message_filters() {
-    QString filter_text = messages_search_filter->text();
+AdminDataService::MessageFilter ServerMainWindow::current_message_filter() const {
+    AdminDataService::MessageFilter filter;
+    filter.text = messages_search_filter->text();
     int filter_type_idx = messages_filter_combo->currentIndex();
-
-    QString query_string = "SELECT message_id, sender_id, receiver_id, message_text, timestamp, type FROM messages";
-    QStringList conditions;
-
-    // Фильтр по тексту
-    if (!filter_text.isEmpty()) {
-        // Используем LIKE с LIKE_ESCAPE для безопасности, хотя здесь это не критично
-        // Но для больших проектов это важно. Для простоты, просто LIKE.
-        conditions << "message_text ILIKE '%" + filter_text + "%'";
-    }
-
-    // Фильтр по типу
     if (filter_type_idx == 1) { // Публичные
-        conditions << "type = 'public'";
+        filter.type = AdminDataService::MessageFilter::Type::Public;
     }
     else if (filter_type_idx == 2) { // Приватные
-        conditions << "type = 'private'";
+        filter.type = AdminDataService::MessageFilter::Type::Private;
     }
+    filter.include_archive = messages_include_archive_check->isChecked();
+    return filter;
+}
 
-    if (!conditions.isEmpty()) {
-        query_string += " WHERE " + conditions.join(" AND ");
-    }
-    query_string += " ORDER BY timestamp DESC"; // Сортируем по времени
-
-    messages_sql_model->setQuery(query_string);
+void ServerMainWindow::apply_message_filters() {
+    AdminDataService::MessageFilter filter = current_message_filter();
+    messages_model->reset([this, filter](qint64 afterKey, int limit) {
+        return data_service.selectMessages(filter, afterKey, limit);
+        });
     messages_table->resizeColumnsToContents();
 }
 
-void ServerMainWindow::on_user_selection_changed() {
-    QModelIndexList selected_indexes = users_table->selectionModel()->selectedRows();
-    bool has_selection = !selected_indexes.isEmpty();
+void ServerMainWindow::load_new_messages() {
+    if (!messages_model->fullyLoaded()) return; // Новые строки придут с оставшимися страницами
+    QSqlQuery query = data_service.selectMessages(current_message_filter(), messages_model->maxKey());
+    if (!query.isActive()) return;
+    messages_model->upsert(query);
+}
+
+void ServerMainWindow::load_new_users() {
+    if (!users_model->fullyLoaded()) return;
+    QSqlQuery query = data_service.selectNewUsers(users_model->maxKey());
+    if (!query.isActive()) return;
+    users_model->upsert(query);
+}
+
+void ServerMainWindow::load_user_rows(const QList<int>& userIds) {
+    if (userIds.isEmpty()) return;
+    QSqlQuery query = data_service.selectUserRows(userIds);
+    if (!query.isActive()) return;
+    users_model->upsert(query);
+    on_user_selection_changed();
+}
+
+void ServerMainWindow::on_users_changed(const QList<int>& userIds) {
+    for (int userId : userIds) pending_user_ids.insert(userId);
+    if (!live_apply_timer->isActive()) live_apply_timer->start();
+}
 
-    if (has_selection) {
-        QModelIndex selected_index = selected_indexes.first();
-        QSqlRecord record = users_sql_model->record(selected_index.row());
+void ServerMainWindow::on_message_inserted(int messageId) {
+    Q_UNUSED(messageId); // Новые строки выбираются одним запросом по последнему увиденному id
+    pending_messages = true;
+    if (!live_apply_timer->isActive()) live_apply_timer->start();
+}
+
+void ServerMainWindow::apply_live_updates() {
+    if (pending_messages) {
+        pending_messages = false;
+        load_new_messages();
+    }
+    if (!pending_user_ids.isEmpty()) {
+        QList<int> ids = pending_user_ids.values();
+        pending_user_ids.clear();
+        load_user_rows(ids);
+    }
+}
 
-        QString status = record.value("status").toString();
-        bool is_banned = (status == "banned");
-        bool is_disconnected = (status == "disconnected");
+void ServerMainWindow::poll_live_updates() {
+    // Без уведомлений видны только новые строки; изменения статусов из этой
+    // панели применяются сразу через load_user_rows.
+    load_new_messages();
+    load_new_users();
+}
 
-        ban_user_button->setEnabled(!is_banned && !is_disconnected); // Забанить, если активен
-        unban_user_button->setEnabled(is_banned); // Разбанить, если забанен
-        disconnect_user_button->setEnabled(!is_banned && !is_disconnected); // Отключить, если активен и не отключен
+QList<int> ServerMainWindow::target_user_rows() const {
+    QList<int> rows;
+    if (apply_to_matching_check->isChecked()) {
+        // "Все найденные" - по всей таблице, а не по загруженным страницам
+        while (users_model->canFetchMore()) users_model->fetchMore();
+        for (int i = 0; i < users_proxy_model->rowCount(); ++i) {
+            rows << users_proxy_model->mapToSource(users_proxy_model->index(i, 0)).row();
+        }
     }
     else {
-        ban_user_button->setEnabled(false);
-        unban_user_button->setEnabled(false);
-        disconnect_user_button->setEnabled(false);
+        for (const QModelIndex& index : users_table->selectionModel()->selectedRows()) {
+            rows << users_proxy_model->mapToSource(index).row();
+        }
+    }
+    return rows;
+}
+
+// id целевых пользователей с нужным статусом и их описание для диалогов
+QList<int> ServerMainWindow::target_user_ids(UserStatus status, QString* description) const {
+    int id_column = users_model->fieldIndex("user_id");
+    int name_column = users_model->fieldIndex("username");
+
+    QList<int> ids;
+    QString first_username;
+    for (int row : target_user_rows()) {
+        int userId = users_model->index(row, id_column).data().toInt();
+        if (db_manager->userStatus(userId) != status) continue;
+        if (ids.isEmpty()) first_username = users_model->index(row, name_column).data().toString();
+        ids << userId;
+    }
+
+    if (description) {
+        *description = ids.size() == 1
+            ? QString("'%1' (ID: %2)").arg(first_username).arg(ids.first())
+            : QString("%1 пользователей").arg(ids.size());
+    }
+    return ids;
+}
+
+int ServerMainWindow::run_bulk_operation(const QString& label, int total, const std::function<int(const DatabaseManager::BulkProgress&)>& operation) {
+    if (total < kBulkProgressThreshold) {
+        return operation(DatabaseManager::BulkProgress());
     }
+
+    QProgressDialog progress(label, "Отмена", 0, total, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(0);
+    int result = operation([&progress](int done, int) {
+        progress.setValue(done); // Для модального диалога обрабатывает события
+        return !progress.wasCanceled();
+    });
+    progress.setValue(total);
+    return result;
+}
+
+void ServerMainWindow::on_user_selection_changed() {
+    // Кнопки доступны, если среди целей есть пользователи в подходящем статусе
+    int id_column = users_model->fieldIndex("user_id");
+    bool has_active = false;
+    bool has_banned = false;
+
+    for (int row : target_user_rows()) {
+        UserStatus status = db_manager->userStatus(users_model->index(row, id_column).data().toInt());
+        has_active = has_active || status == UserStatus::Active;
+        has_banned = has_banned || status == UserStatus::Banned;
+        if (has_active && has_banned) break;
+    }
+
+    ban_user_button->setEnabled(has_active); // Забанить, если активен
+    unban_user_button->setEnabled(has_banned); // Разбанить, если забанен
+    disconnect_user_button->setEnabled(has_active); // Отключить, если активен и не отключен
 }
 
 void ServerMainWindow::on_user_table_double_clicked(const QModelIndex& index) {
     if (index.isValid()) {
-        QSqlRecord record = users_sql_model->record(index.row());
-        QString status = record.value("status").toString();
+        QSqlRecord record = users_model->record(users_proxy_model->mapToSource(index).row());
+        UserStatus status = db_manager->userStatus(record.value("user_id").toInt());
 
-        if (status == "active") {
+        if (status == UserStatus::Active) {
             on_ban_user_button_clicked();
         }
-        else if (status == "banned") {
+        else if (status == UserStatus::Banned) {
             on_unban_user_button_clicked();
         }
-        else if (status == "disconnected") {
+        else if (status == UserStatus::Disconnected) {
             // Можно предложить переподключить или что-то другое
         }
     }
 }
 
 void ServerMainWindow::on_disconnect_user_button_clicked() {
-    QModelIndex selected_index = users_table->selectionModel()->selectedRows().first();
-    if (!selected_index.isValid()) return;
-
-    QSqlRecord record = users_sql_model->record(selected_index.row());
-    int userId = record.value("user_id").toInt();
-    QString username = record.value("username").toString();
+    QString description;
+    QList<int> userIds = target_user_ids(UserStatus::Active, &description);
+    if (userIds.isEmpty()) return;
 
     if (QMessageBox::question(this, "Отключение пользователя",
-        QString("Вы уверены, что хотите временно отключить пользователя '%1' (ID: %2)?\n"
-            "Это действие не является баном, а лишь временным разрывом соединения.").arg(username).arg(userId)) == QMessageBox::Yes) {
+        QString("Вы уверены, что хотите временно отключить %1?\n"
+            "Это действие не является баном, а лишь временным разрывом соединения.").arg(description)) == QMessageBox::Yes) {
 
-        if (db_manager->setUserStatus(userId, "disconnected")) {
-            QMessageBox::information(this, "Успех", QString("Пользователь '%1' был отключен. Сообщите ему о необходимости повторного подключения.").arg(username));
-            refresh_user_list();
+        int affected = run_bulk_operation("Отключение пользователей...", userIds.size(), [&](const DatabaseManager::BulkProgress& progress) {
+            return db_manager->setUsersStatus(userIds, "disconnected", progress);
+        });
+        if (affected >= 0) {
+            QMessageBox::information(this, "Успех", QString("Отключено: %1. Сообщите о необходимости повторного подключения.").arg(description));
+            load_user_rows(userIds);
         }
         else {
-            QMessageBox::critical(this, "Ошибка", "Не удалось отключить пользователя. Проверьте логи сервера.");
+            QMessageBox::critical(this, "Ошибка", "Не удалось отключить пользователей. Изменения отменены, проверьте логи сервера.");
         }
     }
 }
 
 void ServerMainWindow::on_ban_user_button_clicked() {
-    QModelIndex selected_index = users_table->selectionModel()->selectedRows().first();
-    if (!selected_index.isValid()) return;
+    QString description;
+    QList<int> userIds = target_user_ids(UserStatus::Active, &description);
+    if (userIds.isEmpty()) return;
 
-    QSqlRecord record = users_sql_model->record(selected_index.row());
-    int userId = record.value("user_id").toInt();
-    QString username = record.value("username").toString();
-
-    ban_dialog->setUserId(userId, username);
+    ban_dialog->setUserIds(userIds, description);
     ban_dialog->show();
 }
 
 void ServerMainWindow::on_unban_user_button_clicked() {
-    QModelIndex selected_index = users_table->selectionModel()->selectedRows().first();
-    if (!selected_index.isValid()) return;
-
-    QSqlRecord record = users_sql_model->record(selected_index.row());
-    int userId = record.value("user_id").toInt();
-    QString username = record.value("username").toString();
+    QString description;
+    QList<int> userIds = target_user_ids(UserStatus::Banned, &description);
+    if (userIds.isEmpty()) return;
 
     if (QMessageBox::question(this, "Разбан пользователя",
-        QString("Вы уверены, что хотите снять бан с пользователя '%1' (ID: %2)?").arg(username).arg(userId)) == QMessageBox::Yes) {
+        QString("Вы уверены, что хотите снять бан с %1?").arg(description)) == QMessageBox::Yes) {
 
-        if (db_manager->unbanUser(userId)) { // Используем unbanUser, который устанавливает статус 'active'
-            QMessageBox::information(this, "Успех", QString("Бан с пользователя '%1' снят.").arg(username));
-            refresh_user_list();
+        int affected = run_bulk_operation("Снятие банов...", userIds.size(), [&](const DatabaseManager::BulkProgress& progress) {
+            return db_manager->setUsersStatus(userIds, "active", progress); // Как unbanUser: статус 'active'
+        });
+        if (affected >= 0) {
+            QMessageBox::information(this, "Успех", QString("Бан снят: %1.").arg(description));
+            load_user_rows(userIds);
         }
         else {
-            QMessageBox::critical(this, "Ошибка", "Не удалось снять бан с пользователя. Проверьте логи сервера.");
+            QMessageBox::critical(this, "Ошибка", "Не удалось снять бан. Изменения отменены, проверьте логи сервера.");
         }
     }
 }
 
-void ServerMainWindow::process_ban_user_dialog(int userId, const QString& reason, const QDateTime& endDate) {
-    if (db_manager->banUser(userId, reason, endDate)) {
-        QMessageBox::information(this, "Бан пользователя", "Пользователь успешно забанен.");
-        refresh_user_list();
+void ServerMainWindow::process_ban_user_dialog(const QList<int>& userIds, const QString& reason, const QDateTime& endDate) {
+    int affected = run_bulk_operation("Бан пользователей...", userIds.size(), [&](const DatabaseManager::BulkProgress& progress) {
+        return db_manager->banUsers(userIds, reason, endDate, progress);
+    });
+    if (affected >= 0) {
+        QMessageBox::information(this, "Бан пользователя", QString("Забанено пользователей: %1.").arg(affected));
+        load_user_rows(userIds);
     }
     else {
-        QMessageBox::critical(this, "Ошибка", "Не удалось забанить пользователя. Проверьте логи сервера.");
+        QMessageBox::critical(this, "Ошибка", "Не удалось забанить пользователей. Изменения отменены, проверьте логи сервера.");
     }
 }
 
+void ServerMainWindow::on_export_users_button_clicked() {
+    start_export(ExportWorker::Table::Users, "Экспорт пользователей");
+}
+
+void ServerMainWindow::on_export_messages_button_clicked() {
+    start_export(ExportWorker::Table::Messages, "Экспорт сообщений");
+}
+
+void ServerMainWindow::refresh_query_stats() {
+    query_stats_view->setPlainText(db_manager->queryStatsReport());
+}
+
+void ServerMainWindow::start_export(ExportWorker::Table table, const QString& title) {
+    QString path = QFileDialog::getSaveFileName(this, title, QString(),
+        "CSV, сжатый gzip (*.csv.gz);;CSV (*.csv)");
+    if (path.isEmpty()) return;
+
+    QThread* thread = new QThread(this);
+    ExportWorker* worker = new ExportWorker(db_manager, table, path);
+    worker->moveToThread(thread);
+
+    QProgressDialog* progress = new QProgressDialog(title + "...", "Отмена", 0, 0, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(0);
+
+    connect(thread, &QThread::started, worker, &ExportWorker::run);
+    // Рабочий поток занят run(), поэтому отмена вызывается напрямую (атомарный флаг)
+    connect(progress, &QProgressDialog::canceled, worker, &ExportWorker::cancel, Qt::DirectConnection);
+    connect(worker, &ExportWorker::progress, progress, [progress](qint64 rows, qint64 total) {
+        // Оценка по статистике может быть меньше фактического числа строк
+        int maximum = total > 0 ? static_cast<int>(qMin<qint64>(qMax(total, rows), std::numeric_limits<int>::max())) : 0;
+        progress->setMaximum(maximum);
+        progress->setValue(static_cast<int>(qMin<qint64>(rows, maximum)));
+        progress->setLabelText(QString("Выгружено строк: %1").arg(rows));
+    });
+    connect(worker, &ExportWorker::finished, this, [this, thread, worker, progress, path](bool ok, qint64 rows, const QString& error) {
+        progress->close();
+        if (ok) {
+            QMessageBox::information(this, "Экспорт", QString("Выгружено строк: %1\nФайл: %2").arg(rows).arg(path));
+        }
+        else {
+            QMessageBox::warning(this, "Экспорт", error);
+        }
+        thread->quit(); // Соединение рабочего потока вернется в пул при его завершении
+        worker->deleteLater();
+    });
+    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
+
+    progress->show();
+    thread->start();
+}
+
 // --- main.cpp ---
 int main(int argc, char* argv[]) {
+    // Безголовый режим: бенчмарк путей данных панели, дисплей не нужен
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--benchmark") == 0) {
+            QCoreApplication app(argc, argv);
+            return AdminBenchmark(DatabaseConfig::fromArguments(app.arguments()), app.arguments()).run();
+        }
+    }
+
     QApplication a(argc, argv);
 
     // Установка стиля для улучшения внешнего вида (опционально)
@@ -728,7 +3224,26 @@ int main(int argc, char* argv[]) {
     // Или можно использовать системную тему, если она доступна.
     // QApplication::setStyle("Fusion"); // Попробуйте разные стили, если доступны
 
-    ServerMainWindow mainWindow;
+    DatabaseConfig config = DatabaseConfig::fromArguments(a.arguments());
+    DatabaseManager* db_manager = new DatabaseManager(config);
+    if (!db_manager->connectToDatabase()) {
+        QMessageBox::critical(nullptr, "Ошибка базы данных", "Не удалось подключиться к базе данных. Убедитесь, что PostgreSQL запущен и настроен. Проверьте имя пользователя, пароль и имя базы данных (--pg-host, --pg-db, --pg-user, --pg-password) или запустите с --sqlite <файл> / --memory.");
+        delete db_manager;
+        return 1; // Без БД работать нечего
+    }
+
+    // Нагрузочные данные: --generate-users N --generate-messages M
+    if (config.generate_users > 0 || config.generate_messages > 0) {
+        QElapsedTimer timer;
+        timer.start();
+        bool generated = db_manager->generateTestData(config.generate_users, config.generate_messages, [](int done, int total) {
+            qDebug() << "Generated" << done << "of" << total << "rows";
+            return true;
+            });
+        qDebug() << (generated ? "Test data generated in" : "Test data generation failed after") << timer.elapsed() << "ms";
+    }
+
+    ServerMainWindow mainWindow(db_manager);
     mainWindow.show();
 
     return a.exec();